@@ -0,0 +1,87 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __GPIO_RING_H__
+#define __GPIO_RING_H__
+
+#include <stdint.h>
+#include "os/os.h"
+#include "hal/hal_gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gpio_ring_pin;
+
+/* Called from the drain event with the level and os_cputime of the edge */
+typedef void gpio_ring_fn(struct gpio_ring_pin *gp, int level, uint32_t ts);
+
+/* Per-pin edge coalescing, zero fields let every edge through */
+struct gpio_ring_coalesce {
+    uint32_t min_interval_us;           /* least spacing of passed edges */
+    uint32_t pulse_max_us;              /* a shorter pulse is one record */
+    uint16_t rate_max;                  /* passed edges per rate window */
+    uint32_t rate_window_us;
+};
+
+struct gpio_ring_pin {
+    int pin;
+    gpio_ring_fn *fn;                   /* NULL while released */
+    void *arg;
+    uint8_t gen;                        /* bumped on release and init */
+    uint32_t drops;                     /* edges lost to a full ring */
+    uint32_t suppressed;                /* edges over the interval or rate */
+    uint32_t collapsed;                 /* trailing edges of short pulses */
+
+    /* Coalescing in os_cputime ticks, used from the ISR */
+    uint32_t min_interval;
+    uint32_t pulse_max;
+    uint32_t rate_window;
+    uint16_t rate_max;
+    uint8_t coalesce_set;
+
+    /* Queues the level once a window with suppressed edges ends */
+    struct os_callout recheck;
+
+    /* Filter state */
+    uint8_t passed;
+    uint8_t pulse_open;
+    uint8_t last_level;
+    uint16_t window_count;
+    uint32_t window_start;
+    uint32_t last_ts;
+};
+
+int gpio_ring_pin_init(struct gpio_ring_pin *gp, int pin,
+                       hal_gpio_irq_trig_t trig, hal_gpio_pull_t pull,
+                       gpio_ring_fn *fn, void *arg);
+void gpio_ring_pin_release(struct gpio_ring_pin *gp);
+void gpio_ring_pin_coalesce(struct gpio_ring_pin *gp,
+                            const struct gpio_ring_coalesce *co);
+void gpio_ring_inject(struct gpio_ring_pin *gp);
+int gpio_ring_evq_set(struct os_eventq *evq);
+struct os_eventq *gpio_ring_evq_get(void);
+uint32_t gpio_ring_drops(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GPIO_RING_H__ */
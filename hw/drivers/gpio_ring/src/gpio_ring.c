@@ -0,0 +1,385 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "os/os_cputime.h"
+#include "sysinit/sysinit.h"
+#include "hal/hal_gpio.h"
+#include "gpio_ring/gpio_ring.h"
+
+/*
+ * Every GPIO interrupt appends a (pin, level, cputime) record and posts
+ * the one drain event, so edges that fire back to back each keep their
+ * own record instead of overwriting a shared event argument.
+ *
+ * The ring is single producer, single consumer without locks: the GPIO
+ * interrupts share one priority and never preempt each other, and only
+ * the drain moves the tail. Task context producers go through
+ * gpio_ring_inject(), which masks interrupts around the push.
+ *
+ * A noisy line is filtered in the ISR before it reaches the ring: the
+ * trailing edge of a pulse shorter than pulse_max is folded into the
+ * leading one, edges closer than min_interval to the last passed edge
+ * are dropped, and at most rate_max edges pass per rate_window. That
+ * bounds the events a pin can post however fast it toggles. An edge
+ * that is filtered out may be the last one, leaving a latched or level
+ * line asserted without anything in the ring, so the end of the window
+ * that swallowed it queues a record with the settled level.
+ */
+
+#define GPIO_RING_SIZE  MYNEWT_VAL(GPIO_RING_SIZE)
+#define GPIO_RING_MASK  (GPIO_RING_SIZE - 1)
+
+#if (GPIO_RING_SIZE & GPIO_RING_MASK) != 0
+#error "GPIO_RING_SIZE must be a power of two"
+#endif
+
+struct gpio_ring_rec {
+    struct gpio_ring_pin *gp;
+    uint32_t ts;
+    uint8_t level;
+    uint8_t gen;                        /* of the pin when pushed */
+};
+
+/* Volatile so the record is stored before the head that publishes it */
+static volatile struct gpio_ring_rec gpio_ring_recs[GPIO_RING_SIZE];
+static volatile uint16_t gpio_ring_head;
+static volatile uint16_t gpio_ring_tail;
+static volatile uint32_t gpio_ring_dropped;
+static struct os_eventq *gpio_ring_evq;
+static uint8_t gpio_ring_evq_fixed;
+
+static const struct gpio_ring_coalesce gpio_ring_coalesce_dflt = {
+    .min_interval_us = MYNEWT_VAL(GPIO_RING_MIN_INTERVAL_US),
+    .pulse_max_us = 0,
+    .rate_max = MYNEWT_VAL(GPIO_RING_RATE_MAX),
+    .rate_window_us = MYNEWT_VAL(GPIO_RING_RATE_WINDOW_MS) * 1000,
+};
+
+static void gpio_ring_drain(struct os_event *ev);
+
+static struct os_event gpio_ring_ev = {
+    .ev_cb = gpio_ring_drain,
+};
+
+/**
+ * @return The event queue edge handlers run on. Drivers run the rest of
+ *         their interrupt work there too, so it never races a handler.
+ */
+struct os_eventq *
+gpio_ring_evq_get(void)
+{
+    return gpio_ring_evq ? gpio_ring_evq : os_eventq_dflt_get();
+}
+
+static void
+gpio_ring_push(struct gpio_ring_pin *gp, int level, uint32_t ts)
+{
+    volatile struct gpio_ring_rec *rec;
+    uint16_t head;
+
+    head = gpio_ring_head;
+    if ((uint16_t)(head - gpio_ring_tail) >= GPIO_RING_SIZE) {
+        gp->drops++;
+        gpio_ring_dropped++;
+    } else {
+        rec = &gpio_ring_recs[head & GPIO_RING_MASK];
+        rec->gp = gp;
+        rec->ts = ts;
+        rec->level = level;
+        rec->gen = gp->gen;
+        gpio_ring_head = head + 1;
+    }
+
+    os_eventq_put(gpio_ring_evq_get(), &gpio_ring_ev);
+}
+
+static void
+gpio_ring_drain(struct os_event *ev)
+{
+    volatile struct gpio_ring_rec *rec;
+    struct gpio_ring_pin *gp;
+    uint32_t ts;
+    uint16_t tail;
+    uint8_t gen;
+    int level;
+    int n;
+
+    tail = gpio_ring_tail;
+    for (n = 0; n < GPIO_RING_SIZE && tail != gpio_ring_head; n++) {
+        rec = &gpio_ring_recs[tail & GPIO_RING_MASK];
+        gp = rec->gp;
+        ts = rec->ts;
+        level = rec->level;
+        gen = rec->gen;
+
+        /* Free the slot first, handlers may inject */
+        gpio_ring_tail = ++tail;
+
+        /* Edges from before a release belong to the old handler */
+        if (gp->fn && gen == gp->gen) {
+            gp->fn(gp, level, ts);
+        }
+    }
+
+    /* Let other events run between batches on a busy line */
+    if (tail != gpio_ring_head) {
+        os_eventq_put(gpio_ring_evq_get(), &gpio_ring_ev);
+    }
+}
+
+static void
+gpio_ring_recheck(struct os_event *ev)
+{
+    struct gpio_ring_pin *gp;
+
+    gp = ev->ev_arg;
+    if (gp->fn) {
+        gpio_ring_inject(gp);
+    }
+}
+
+/* Called from the ISR with an edge filtered out until cputime due */
+static void
+gpio_ring_recheck_at(struct gpio_ring_pin *gp, uint32_t ts, uint32_t due)
+{
+    uint32_t ticks;
+
+    /* One pending check reads the level after every edge before it */
+    if (os_callout_queued(&gp->recheck)) {
+        return;
+    }
+
+    ticks = (uint64_t)os_cputime_ticks_to_usecs(due - ts) *
+            OS_TICKS_PER_SEC / 1000000 + 1;
+    os_callout_reset(&gp->recheck, ticks);
+}
+
+static int
+gpio_ring_filter(struct gpio_ring_pin *gp, int level, uint32_t ts)
+{
+    if (gp->pulse_open) {
+        gp->pulse_open = 0;
+        if (level != gp->last_level && ts - gp->last_ts < gp->pulse_max) {
+            gp->collapsed++;
+            gpio_ring_recheck_at(gp, ts, gp->last_ts + gp->pulse_max);
+            return 0;
+        }
+    }
+
+    if (gp->min_interval && gp->passed &&
+        ts - gp->last_ts < gp->min_interval) {
+        gp->suppressed++;
+        gpio_ring_recheck_at(gp, ts, gp->last_ts + gp->min_interval);
+        return 0;
+    }
+
+    if (gp->rate_max) {
+        if (ts - gp->window_start >= gp->rate_window) {
+            gp->window_start = ts;
+            gp->window_count = 0;
+        }
+        if (gp->window_count >= gp->rate_max) {
+            gp->suppressed++;
+            gpio_ring_recheck_at(gp, ts,
+                                 gp->window_start + gp->rate_window);
+            return 0;
+        }
+        gp->window_count++;
+    }
+
+    /* This edge carries the level, nothing left to check */
+    os_callout_stop(&gp->recheck);
+
+    gp->passed = 1;
+    gp->last_ts = ts;
+    gp->last_level = level;
+    gp->pulse_open = (gp->pulse_max != 0);
+
+    return 1;
+}
+
+static void
+gpio_ring_irq(void *arg)
+{
+    struct gpio_ring_pin *gp;
+    uint32_t ts;
+    int level;
+
+    gp = arg;
+    level = hal_gpio_read(gp->pin);
+    ts = os_cputime_get32();
+
+    if (gpio_ring_filter(gp, level, ts)) {
+        gpio_ring_push(gp, level, ts);
+    }
+}
+
+static void
+gpio_ring_set_coalesce(struct gpio_ring_pin *gp,
+                       const struct gpio_ring_coalesce *co)
+{
+    gp->min_interval = os_cputime_usecs_to_ticks(co->min_interval_us);
+    gp->pulse_max = os_cputime_usecs_to_ticks(co->pulse_max_us);
+    gp->rate_window = os_cputime_usecs_to_ticks(co->rate_window_us);
+    gp->rate_max = co->rate_max;
+}
+
+/**
+ * Arms the GPIO interrupt of a pin so its edges go through the ring
+ *
+ * @param The pin state, must stay valid while armed
+ * @param The GPIO
+ * @param The edges to catch
+ * @param The pull to apply
+ * @param The handler, called from the drain event for each edge
+ * @param Argument for the handler, available as gp->arg
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+gpio_ring_pin_init(struct gpio_ring_pin *gp, int pin,
+                   hal_gpio_irq_trig_t trig, hal_gpio_pull_t pull,
+                   gpio_ring_fn *fn, void *arg)
+{
+    int rc;
+
+    gp->pin = pin;
+    gp->fn = fn;
+    gp->arg = arg;
+    gp->gen++;
+
+    /* Pins nobody tuned get the syscfg defaults */
+    if (!gp->coalesce_set) {
+        gpio_ring_set_coalesce(gp, &gpio_ring_coalesce_dflt);
+    }
+    gp->passed = 0;
+    gp->pulse_open = 0;
+    gp->window_count = 0;
+    gpio_ring_evq_fixed = 1;
+    os_callout_stop(&gp->recheck);
+    os_callout_init(&gp->recheck, gpio_ring_evq_get(), gpio_ring_recheck, gp);
+
+    rc = hal_gpio_irq_init(pin, gpio_ring_irq, gp, trig, pull);
+    if (rc != 0) {
+        gp->fn = NULL;
+        return rc;
+    }
+    hal_gpio_irq_enable(pin);
+
+    return 0;
+}
+
+/**
+ * Releases the GPIO interrupt of a pin, edges still in the ring are
+ * dropped by the drain, even once the pin is armed again
+ *
+ * @param The pin state
+ */
+void
+gpio_ring_pin_release(struct gpio_ring_pin *gp)
+{
+    if (gp->fn == NULL) {
+        return;
+    }
+
+    hal_gpio_irq_release(gp->pin);
+    os_callout_stop(&gp->recheck);
+    gp->fn = NULL;
+    gp->gen++;
+}
+
+/**
+ * Sets the edge coalescing of a pin, kept across release and init
+ *
+ * @param The pin state
+ * @param The coalescing, all zero passes every edge
+ */
+void
+gpio_ring_pin_coalesce(struct gpio_ring_pin *gp,
+                       const struct gpio_ring_coalesce *co)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    gpio_ring_set_coalesce(gp, co);
+    gp->coalesce_set = 1;
+    gp->passed = 0;
+    gp->pulse_open = 0;
+    gp->window_count = 0;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Queues a record with the current level of an armed pin, for a level
+ * that has to be handled but will not give an edge. Injected records
+ * skip the coalescing.
+ *
+ * @param The pin state
+ */
+void
+gpio_ring_inject(struct gpio_ring_pin *gp)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    gpio_ring_push(gp, hal_gpio_read(gp->pin), os_cputime_get32());
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Moves the drain to another event queue. The queue can only be chosen
+ * once, before any pin is armed; the default queue is used until then.
+ *
+ * @param The event queue
+ *
+ * @return 0 on success or when evq is already the drain queue, SYS_EBUSY
+ *         when the drain is fixed on another queue.
+ */
+int
+gpio_ring_evq_set(struct os_eventq *evq)
+{
+    if (evq == gpio_ring_evq_get()) {
+        gpio_ring_evq_fixed = 1;
+        return 0;
+    }
+
+    if (gpio_ring_evq_fixed) {
+        return SYS_EBUSY;
+    }
+
+    gpio_ring_evq = evq;
+    gpio_ring_evq_fixed = 1;
+
+    return 0;
+}
+
+/**
+ * @return The number of edges lost to a full ring on all pins.
+ */
+uint32_t
+gpio_ring_drops(void)
+{
+    return gpio_ring_dropped;
+}
@@ -0,0 +1,120 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __REGMAP_H__
+#define __REGMAP_H__
+
+#include <stdint.h>
+#include "os/os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum regmap_bus_type {
+    REGMAP_BUS_I2C,
+    REGMAP_BUS_SPI
+};
+
+/* How to reach the device, shared by every transfer */
+struct regmap_bus {
+    uint8_t type;                       /* enum regmap_bus_type */
+    uint8_t num;                        /* hal bus number */
+    uint8_t addr;                       /* I2C address */
+    int ss_pin;                         /* SPI chip select, driven low */
+    uint8_t read_flag;                  /* ORed into the SPI address to read */
+    uint8_t inc_flag;                   /* ORed into the SPI address of bursts */
+    uint32_t timeout;                   /* I2C timeout in OS ticks */
+};
+
+/* One destination of a scattered read */
+struct regmap_iov {
+    uint8_t *buf;
+    uint16_t len;
+};
+
+/* Register flags */
+#define REGMAP_F_VOLATILE       (1 << 0)    /* changed by the chip, or the
+                                             * access has a side effect */
+#define REGMAP_F_RO             (1 << 1)
+#define REGMAP_F_WO             (1 << 2)
+
+/* Cache entry state */
+#define REGMAP_S_VALID          (1 << 0)
+#define REGMAP_S_DIRTY          (1 << 1)
+
+struct regmap_cfg {
+    struct regmap_bus bus;
+    uint8_t max_reg;
+    const uint8_t *flags;               /* max_reg + 1 REGMAP_F_*, or NULL */
+};
+
+struct regmap_ent {
+    uint8_t val;
+    uint8_t state;
+};
+
+struct regmap {
+    const struct regmap_cfg *cfg;
+    struct regmap_ent *ents;            /* max_reg + 1 entries */
+    struct os_mutex lock;               /* cache, bus and deferral */
+    uint8_t deferred;
+    uint32_t xfers;                     /* bus transactions issued */
+    uint32_t skips;                     /* writes the cache made needless */
+};
+
+/* One step of a register table: replace the mask bits of reg with val */
+struct regmap_seq {
+    uint8_t reg;
+    uint8_t val;
+    uint8_t mask;
+};
+
+int regmap_bus_write(const struct regmap_bus *bus, uint8_t reg,
+                     const uint8_t *buf, uint16_t len, uint32_t timeout,
+                     uint8_t last_op);
+int regmap_bus_readv(const struct regmap_bus *bus, uint8_t reg,
+                     const struct regmap_iov *iov, int iovcnt,
+                     uint32_t timeout, uint8_t last_op);
+int regmap_bus_read(const struct regmap_bus *bus, uint8_t reg, uint8_t *buf,
+                    uint16_t len, uint32_t timeout, uint8_t last_op);
+
+int regmap_init(struct regmap *map, const struct regmap_cfg *cfg,
+                struct regmap_ent *ents);
+void regmap_drop(struct regmap *map);
+int regmap_read(struct regmap *map, uint8_t reg, uint8_t *val);
+int regmap_write(struct regmap *map, uint8_t reg, uint8_t val);
+int regmap_update_bits(struct regmap *map, uint8_t reg, uint8_t mask,
+                       uint8_t val);
+int regmap_readv(struct regmap *map, uint8_t reg,
+                 const struct regmap_iov *iov, int iovcnt);
+int regmap_readlen(struct regmap *map, uint8_t reg, uint8_t *buf,
+                   uint16_t len);
+int regmap_writelen(struct regmap *map, uint8_t reg, const uint8_t *buf,
+                    uint16_t len);
+void regmap_defer(struct regmap *map);
+int regmap_flush(struct regmap *map);
+int regmap_seq_apply(struct regmap *map, const struct regmap_seq *seq,
+                     int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __REGMAP_H__ */
@@ -0,0 +1,612 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "syscfg/syscfg.h"
+#include "hal/hal_gpio.h"
+#include "hal/hal_i2c.h"
+#include "hal/hal_spi.h"
+#include "regmap/regmap.h"
+
+/**
+ * Writes a run of registers starting at reg, bypassing any cache
+ *
+ * @param The bus the device is on
+ * @param The first register address to write to
+ * @param The values to write
+ * @param Number of bytes, at most REGMAP_BURST_MAX on I2C
+ * @param Timeout in OS ticks, I2C only
+ * @param Whether to end with a STOP, I2C only
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_bus_write(const struct regmap_bus *bus, uint8_t reg,
+                 const uint8_t *buf, uint16_t len, uint32_t timeout,
+                 uint8_t last_op)
+{
+    uint8_t payload[1 + MYNEWT_VAL(REGMAP_BURST_MAX)];
+    uint8_t addr;
+    int rc;
+
+    if (bus->type == REGMAP_BUS_I2C) {
+        struct hal_i2c_master_data data_struct = {
+            .address = bus->addr,
+            .len = len + 1,
+            .buffer = payload
+        };
+
+        if (len > MYNEWT_VAL(REGMAP_BURST_MAX)) {
+            return SYS_EINVAL;
+        }
+
+        payload[0] = reg;
+        memcpy(&payload[1], buf, len);
+
+        return hal_i2c_master_write(bus->num, &data_struct, timeout, last_op);
+    }
+
+    addr = reg;
+    if (len > 1) {
+        addr |= bus->inc_flag;
+    }
+
+    hal_gpio_write(bus->ss_pin, 0);
+
+    rc = 0;
+    if (hal_spi_tx_val(bus->num, addr) == 0xFFFF) {
+        rc = SYS_EIO;
+    }
+    if (rc == 0) {
+        rc = hal_spi_txrx(bus->num, (void *)buf, NULL, len);
+    }
+
+    hal_gpio_write(bus->ss_pin, 1);
+
+    return rc;
+}
+
+/**
+ * Reads a run of registers starting at reg, scattering the bytes over the
+ * caller's buffers in order
+ *
+ * On SPI this is one transaction: the address goes out on its own and
+ * every buffer is clocked in place, its old contents shifted out as dummy
+ * bytes while the register data replaces them. On I2C each buffer is a
+ * read of its own, continuing from where the chip's address pointer is.
+ *
+ * @param The bus the device is on
+ * @param The first register address to read from
+ * @param The buffers to fill
+ * @param The number of buffers
+ * @param Timeout in OS ticks, I2C only
+ * @param Whether to end with a STOP, I2C only
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_bus_readv(const struct regmap_bus *bus, uint8_t reg,
+                 const struct regmap_iov *iov, int iovcnt, uint32_t timeout,
+                 uint8_t last_op)
+{
+    uint16_t total;
+    uint8_t addr;
+    int rc;
+    int i;
+
+    if (bus->type == REGMAP_BUS_I2C) {
+        struct hal_i2c_master_data data_struct = {
+            .address = bus->addr,
+            .len = 1,
+            .buffer = &reg
+        };
+
+        /* Register write, repeated start follows */
+        rc = hal_i2c_master_write(bus->num, &data_struct, timeout, 0);
+        if (rc) {
+            goto error;
+        }
+
+        for (i = 0; i < iovcnt; i++) {
+            if (iov[i].len == 0) {
+                continue;
+            }
+            data_struct.len = iov[i].len;
+            data_struct.buffer = iov[i].buf;
+            rc = hal_i2c_master_read(bus->num, &data_struct, timeout,
+                                     i == iovcnt - 1 ? last_op : 0);
+            if (rc) {
+                goto error;
+            }
+        }
+
+        return 0;
+    }
+
+    total = 0;
+    for (i = 0; i < iovcnt; i++) {
+        total += iov[i].len;
+    }
+
+    addr = reg | bus->read_flag;
+    if (total > 1) {
+        addr |= bus->inc_flag;
+    }
+
+    hal_gpio_write(bus->ss_pin, 0);
+
+    rc = 0;
+    if (hal_spi_tx_val(bus->num, addr) == 0xFFFF) {
+        rc = SYS_EIO;
+    }
+
+    for (i = 0; rc == 0 && i < iovcnt; i++) {
+        if (iov[i].len == 0) {
+            continue;
+        }
+        rc = hal_spi_txrx(bus->num, iov[i].buf, iov[i].buf, iov[i].len);
+    }
+
+    hal_gpio_write(bus->ss_pin, 1);
+
+    if (rc) {
+        goto error;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+int
+regmap_bus_read(const struct regmap_bus *bus, uint8_t reg, uint8_t *buf,
+                uint16_t len, uint32_t timeout, uint8_t last_op)
+{
+    struct regmap_iov iov;
+
+    iov.buf = buf;
+    iov.len = len;
+
+    return regmap_bus_readv(bus, reg, &iov, 1, timeout, last_op);
+}
+
+static uint8_t
+regmap_flags(const struct regmap *map, uint8_t reg)
+{
+    return map->cfg->flags ? map->cfg->flags[reg] : 0;
+}
+
+/*
+ * The cached calls may come from several tasks, e.g. configuration from
+ * the application and interrupt work from the sensor task. The mutex
+ * nests, so calls built on other calls simply take it again. Before the
+ * OS starts pend and release do nothing, which is fine for sysinit.
+ */
+static void
+regmap_lock(struct regmap *map)
+{
+    os_mutex_pend(&map->lock, OS_TIMEOUT_NEVER);
+}
+
+static void
+regmap_unlock(struct regmap *map)
+{
+    os_mutex_release(&map->lock);
+}
+
+/**
+ * Sets up a register map with every cache entry unknown
+ *
+ * @param The map to set up
+ * @param The device description, kept by reference
+ * @param Storage for max_reg + 1 cache entries
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_init(struct regmap *map, const struct regmap_cfg *cfg,
+            struct regmap_ent *ents)
+{
+    if (cfg == NULL || ents == NULL) {
+        return SYS_EINVAL;
+    }
+
+    map->cfg = cfg;
+    map->ents = ents;
+    map->xfers = 0;
+    map->skips = 0;
+    memset(ents, 0, (cfg->max_reg + 1) * sizeof(*ents));
+    map->deferred = 0;
+
+    return os_mutex_init(&map->lock);
+}
+
+/**
+ * Forgets every cached value, for after a chip reset. Pending deferred
+ * writes are dropped too, deferral itself lasts until regmap_flush().
+ *
+ * @param The map to invalidate
+ */
+void
+regmap_drop(struct regmap *map)
+{
+    regmap_lock(map);
+    memset(map->ents, 0, (map->cfg->max_reg + 1) * sizeof(*map->ents));
+    regmap_unlock(map);
+}
+
+/**
+ * Reads a register, from the cache when it holds the value
+ *
+ * @param The map the register is in
+ * @param The register address
+ * @param Pointer to where the register value should be written
+ *
+ * @return 0 on success, SYS_EACCES for a write-only register that was never
+ *         written, other non-zero error on failure.
+ */
+int
+regmap_read(struct regmap *map, uint8_t reg, uint8_t *val)
+{
+    struct regmap_ent *ent;
+    uint8_t flags;
+    int rc;
+
+    if (reg > map->cfg->max_reg) {
+        return SYS_EINVAL;
+    }
+
+    ent = &map->ents[reg];
+    flags = regmap_flags(map, reg);
+
+    regmap_lock(map);
+
+    if (flags & REGMAP_F_VOLATILE) {
+        map->xfers++;
+        rc = regmap_bus_read(&map->cfg->bus, reg, val, 1,
+                             map->cfg->bus.timeout, 1);
+        goto done;
+    }
+
+    if (ent->state & REGMAP_S_VALID) {
+        *val = ent->val;
+        rc = 0;
+        goto done;
+    }
+
+    if (flags & REGMAP_F_WO) {
+        rc = SYS_EACCES;
+        goto done;
+    }
+
+    map->xfers++;
+    rc = regmap_bus_read(&map->cfg->bus, reg, &ent->val, 1,
+                         map->cfg->bus.timeout, 1);
+    if (rc) {
+        goto done;
+    }
+    ent->state = REGMAP_S_VALID;
+    *val = ent->val;
+
+done:
+    regmap_unlock(map);
+    return rc;
+}
+
+/**
+ * Writes a register. A cached register already holding the value is not
+ * written again, and while deferred the value only goes into the cache.
+ *
+ * @param The map the register is in
+ * @param The register address
+ * @param The value to write
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_write(struct regmap *map, uint8_t reg, uint8_t val)
+{
+    struct regmap_ent *ent;
+    uint8_t flags;
+    int rc;
+
+    if (reg > map->cfg->max_reg) {
+        return SYS_EINVAL;
+    }
+
+    ent = &map->ents[reg];
+    flags = regmap_flags(map, reg);
+
+    if (flags & REGMAP_F_RO) {
+        return SYS_EACCES;
+    }
+
+    regmap_lock(map);
+
+    if (flags & REGMAP_F_VOLATILE) {
+        map->xfers++;
+        rc = regmap_bus_write(&map->cfg->bus, reg, &val, 1,
+                              map->cfg->bus.timeout, 1);
+        goto done;
+    }
+
+    rc = 0;
+    if ((ent->state & REGMAP_S_VALID) && ent->val == val) {
+        map->skips++;
+        goto done;
+    }
+
+    if (map->deferred) {
+        ent->val = val;
+        ent->state = REGMAP_S_VALID | REGMAP_S_DIRTY;
+        goto done;
+    }
+
+    map->xfers++;
+    rc = regmap_bus_write(&map->cfg->bus, reg, &val, 1,
+                          map->cfg->bus.timeout, 1);
+    if (rc) {
+        /* Whether the chip took it is unknown */
+        ent->state = 0;
+        goto done;
+    }
+    ent->val = val;
+    ent->state = REGMAP_S_VALID;
+
+done:
+    regmap_unlock(map);
+    return rc;
+}
+
+/**
+ * Replaces the masked bits of a register, writing nothing when the result
+ * is what the register already holds
+ *
+ * @param The map the register is in
+ * @param The register address
+ * @param The bits to replace
+ * @param The new value of those bits
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_update_bits(struct regmap *map, uint8_t reg, uint8_t mask,
+                   uint8_t val)
+{
+    uint8_t cur;
+    uint8_t next;
+    int rc;
+
+    /* Nobody may change the register between the read and the write */
+    regmap_lock(map);
+
+    rc = regmap_read(map, reg, &cur);
+    if (rc) {
+        goto done;
+    }
+
+    next = (cur & ~mask) | (val & mask);
+    if (next == cur) {
+        map->skips++;
+        goto done;
+    }
+
+    rc = regmap_write(map, reg, next);
+
+done:
+    regmap_unlock(map);
+    return rc;
+}
+
+/*
+ * Burst reads go straight to the bus and leave the cache alone: they are
+ * used on data and FIFO registers, where the address may not advance or
+ * may wrap, so the bytes cannot be matched to registers.
+ */
+int
+regmap_readv(struct regmap *map, uint8_t reg, const struct regmap_iov *iov,
+             int iovcnt)
+{
+    int rc;
+
+    regmap_lock(map);
+    map->xfers++;
+    rc = regmap_bus_readv(&map->cfg->bus, reg, iov, iovcnt,
+                          map->cfg->bus.timeout, 1);
+    regmap_unlock(map);
+
+    return rc;
+}
+
+int
+regmap_readlen(struct regmap *map, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    int rc;
+
+    regmap_lock(map);
+    map->xfers++;
+    rc = regmap_bus_read(&map->cfg->bus, reg, buf, len,
+                         map->cfg->bus.timeout, 1);
+    regmap_unlock(map);
+
+    return rc;
+}
+
+/**
+ * Writes a run of registers in one burst and updates their cache entries
+ *
+ * @param The map the registers are in
+ * @param The first register address to write to
+ * @param The values to write
+ * @param Number of bytes to write
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_writelen(struct regmap *map, uint8_t reg, const uint8_t *buf,
+                uint16_t len)
+{
+    struct regmap_ent *ent;
+    uint16_t i;
+    int rc;
+
+    regmap_lock(map);
+
+    map->xfers++;
+    rc = regmap_bus_write(&map->cfg->bus, reg, buf, len,
+                          map->cfg->bus.timeout, 1);
+
+    for (i = 0; i < len && reg + i <= map->cfg->max_reg; i++) {
+        if (regmap_flags(map, reg + i) & REGMAP_F_VOLATILE) {
+            continue;
+        }
+        ent = &map->ents[reg + i];
+        ent->val = buf[i];
+        ent->state = rc ? 0 : REGMAP_S_VALID;
+    }
+
+    regmap_unlock(map);
+
+    return rc;
+}
+
+/**
+ * Holds writes to cached registers in the cache until regmap_flush().
+ * Volatile registers are still written straight away. The map stays
+ * locked to the calling task until the flush, so other tasks neither see
+ * the pending values nor get their writes deferred.
+ *
+ * @param The map to defer writes on
+ */
+void
+regmap_defer(struct regmap *map)
+{
+    regmap_lock(map);
+
+    /* Already holding it from an earlier defer, one flush ends both */
+    if (map->deferred) {
+        regmap_unlock(map);
+        return;
+    }
+    map->deferred = 1;
+}
+
+/**
+ * Writes every dirty register, merging consecutive ones into bursts, ends
+ * deferral and unlocks the map. Registers that failed to write are
+ * forgotten, so writing them again goes to the chip whatever the value.
+ *
+ * @param The map to flush
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_flush(struct regmap *map)
+{
+    uint8_t buf[MYNEWT_VAL(REGMAP_BURST_MAX)];
+    uint16_t start;
+    uint16_t reg;
+    uint16_t len;
+    uint16_t i;
+    uint8_t deferred;
+    int rc;
+    int rc2;
+
+    regmap_lock(map);
+    deferred = map->deferred;
+    map->deferred = 0;
+
+    rc = 0;
+    reg = 0;
+    while (reg <= map->cfg->max_reg) {
+        if (!(map->ents[reg].state & REGMAP_S_DIRTY)) {
+            reg++;
+            continue;
+        }
+
+        /* Gather the run of dirty registers from here */
+        start = reg;
+        len = 0;
+        while (reg <= map->cfg->max_reg &&
+               (map->ents[reg].state & REGMAP_S_DIRTY) &&
+               len < MYNEWT_VAL(REGMAP_BURST_MAX)) {
+            buf[len++] = map->ents[reg++].val;
+        }
+
+        map->xfers++;
+        rc2 = regmap_bus_write(&map->cfg->bus, start, buf, len,
+                               map->cfg->bus.timeout, 1);
+        if (rc2) {
+            rc = rc2;
+        }
+
+        /* Whether the chip took a failed burst is unknown */
+        for (i = start; i < start + len; i++) {
+            map->ents[i].state = rc2 ? 0 : REGMAP_S_VALID;
+        }
+    }
+
+    regmap_unlock(map);
+    if (deferred) {
+        /* The hold taken by regmap_defer() */
+        regmap_unlock(map);
+    }
+
+    return rc;
+}
+
+/**
+ * Applies a register table: every step goes into the cache, then the
+ * registers that changed are written in address order, consecutive ones
+ * as one burst. Steps on volatile registers are written as they come.
+ *
+ * @param The map the registers are in
+ * @param The steps to apply
+ * @param Number of steps
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+regmap_seq_apply(struct regmap *map, const struct regmap_seq *seq, int count)
+{
+    int rc;
+    int rc2;
+    int i;
+
+    regmap_defer(map);
+
+    rc = 0;
+    for (i = 0; i < count; i++) {
+        rc = regmap_update_bits(map, seq[i].reg, seq[i].mask, seq[i].val);
+        if (rc) {
+            break;
+        }
+    }
+
+    /* Steps taken so far still go out */
+    rc2 = regmap_flush(map);
+    if (rc == 0) {
+        rc = rc2;
+    }
+
+    return rc;
+}
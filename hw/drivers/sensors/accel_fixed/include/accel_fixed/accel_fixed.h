@@ -0,0 +1,91 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __ACCEL_FIXED_H__
+#define __ACCEL_FIXED_H__
+
+#include <stdint.h>
+#include "sensor/sensor.h"
+#include "sensor/accel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Readings of struct accel_fixed_data, kept apart from
+ * SENSOR_TYPE_ACCELEROMETER whose listeners expect struct sensor_accel_data
+ */
+#define SENSOR_TYPE_ACCEL_FIXED         SENSOR_TYPE_USER_DEFINED_1
+
+/* Fractional bits of afd_scale */
+#define ACCEL_FIXED_SCALE_SHIFT         (10)
+
+/*
+ * Accelerometer sample without floating point, handed to the data function
+ * of SENSOR_TYPE_ACCEL_FIXED reads.  The leading fields make it a
+ * SENSOR_VALUE_TYPE_INT32_TRIPLET.
+ */
+struct accel_fixed_data {
+    int32_t afd_x;                      /* milli-g */
+    int32_t afd_y;
+    int32_t afd_z;
+    int16_t afd_raw_x;                  /* counts at the current resolution */
+    int16_t afd_raw_y;
+    int16_t afd_raw_z;
+    uint32_t afd_scale;                 /* milli-g per count, Q10 */
+};
+
+/**
+ * Milli-g of a count at a Q10 scale, with a multiply and a shift
+ *
+ * @param The count
+ * @param Milli-g per count, Q10
+ *
+ * @return The acceleration in milli-g
+ */
+static inline int32_t
+accel_fixed_mg(int16_t raw, uint32_t scale)
+{
+    return ((int32_t)raw * (int32_t)scale) >> ACCEL_FIXED_SCALE_SHIFT;
+}
+
+/**
+ * Converts to m/s^2 for consumers that want floats, one multiply per axis
+ *
+ * @param The integer sample
+ * @param The float sample to fill in
+ */
+static inline void
+accel_fixed_to_float(const struct accel_fixed_data *afd,
+                     struct sensor_accel_data *sad)
+{
+    sad->sad_x = (float)afd->afd_x * 0.00980665F;
+    sad->sad_y = (float)afd->afd_y * 0.00980665F;
+    sad->sad_z = (float)afd->afd_z * 0.00980665F;
+    sad->sad_x_is_valid = 1;
+    sad->sad_y_is_valid = 1;
+    sad->sad_z_is_valid = 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCEL_FIXED_H__ */
@@ -23,6 +23,7 @@
 #include "os/os.h"
 #include "os/os_dev.h"
 #include "sensor/sensor.h"
+#include "gpio_ring/gpio_ring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,40 +49,110 @@ enum bma250_accel_rate {
     BMA250_ACCEL_RATE_100000        = 0x0F  /* 1000hz  */
 };
 
-// enum bma250_int_map_0 {
-//     BMA250_INT1_LOW                 = 0x00,
-//     BMA250_INT1_HIGH                = 0x01,
-//     BMA250_INT1_SLOPE               = 0x02,
-//     BMA250_INT1_SLO_NO_MOT          = 0x03,
-//     BMA250_INT1_D_TAP               = 0x04,
-//     BMA250_INT1_S_TAP               = 0x05,
-//     BMA250_INT1_ORIENT              = 0x06,
-//     BMA250_INT1_FLAT                = 0x07
-// };
-
-// enum bma250_int_map_1 {
-//     BMA250_INT1_DATA                = 0x00,
-//     BMA250_INT1_FWM                 = 0x01,
-//     BMA250_INT1_FFULL               = 0x02,
-//     BMA250_INT2_FFULL               = 0x05,
-//     BMA250_INT2_FWM                 = 0x06,
-//     BMA250_INT2_DATA                = 0x07
-// };
-
-// enum bma250_int_map_2 {
-//     BMA250_INT2_LOW                 = 0x00,
-//     BMA250_INT2_HIGH                = 0x01,
-//     BMA250_INT2_SLOPE               = 0x02,
-//     BMA250_INT2_SLO_NO_MOT          = 0x03,
-//     BMA250_INT2_D_TAP               = 0x04,
-//     BMA250_INT2_S_TAP               = 0x05,
-//     BMA250_INT2_ORIENT              = 0x06,
-//     BMA250_INT2_FLAT                = 0x07
-// };
+/* Interrupt sources, combined as masks in bma250_cfg and the event */
+enum bma250_int_src {
+    BMA250_INT_SLOPE                = (1 << 0), /* any-motion */
+    BMA250_INT_NO_MOTION            = (1 << 1),
+    BMA250_INT_TAP                  = (1 << 2),
+    BMA250_INT_DOUBLE_TAP           = (1 << 3),
+    BMA250_INT_ORIENT               = (1 << 4),
+    BMA250_INT_FLAT                 = (1 << 5),
+    BMA250_INT_DATA                 = (1 << 6)  /* runs a sensor_read */
+};
+
+enum bma250_orient {
+    BMA250_ORIENT_PORTRAIT_UPRIGHT  = 0x00,
+    BMA250_ORIENT_PORTRAIT_UPSIDE   = 0x01,
+    BMA250_ORIENT_LANDSCAPE_LEFT    = 0x02,
+    BMA250_ORIENT_LANDSCAPE_RIGHT   = 0x03
+};
+
+struct bma250_int_event {
+    uint8_t sources;                    /* enum bma250_int_src that fired */
+    enum bma250_orient orient;          /* current state, always valid */
+    uint8_t face_down;
+    uint8_t flat;
+    uint8_t status[4];                  /* INT_STATUS_0..3 as read */
+    uint32_t ts;                        /* os_cputime of the INT edge */
+};
+
+enum bma250_pmu_mode {
+    BMA250_PMU_MODE_NORMAL          = 0x00,
+    BMA250_PMU_MODE_LOW_POWER       = 0x40, /* sleeps for sleep_dur between samples */
+    BMA250_PMU_MODE_SUSPEND         = 0x80  /* no sampling, registers kept */
+};
+
+enum bma250_sleep_dur {
+    BMA250_SLEEP_DUR_0_5            = 0x0A, /* 0.5ms */
+    BMA250_SLEEP_DUR_1              = 0x0C, /* 1ms   */
+    BMA250_SLEEP_DUR_2              = 0x0E, /* 2ms   */
+    BMA250_SLEEP_DUR_4              = 0x10, /* 4ms   */
+    BMA250_SLEEP_DUR_6              = 0x12, /* 6ms   */
+    BMA250_SLEEP_DUR_10             = 0x14, /* 10ms  */
+    BMA250_SLEEP_DUR_25             = 0x16, /* 25ms  */
+    BMA250_SLEEP_DUR_50             = 0x18, /* 50ms  */
+    BMA250_SLEEP_DUR_100            = 0x1A, /* 100ms */
+    BMA250_SLEEP_DUR_500            = 0x1C, /* 500ms */
+    BMA250_SLEEP_DUR_1000           = 0x1E  /* 1s    */
+};
+
+/* Value each axis should read after fast offset compensation */
+enum bma250_ofc_target {
+    BMA250_OFC_TARGET_0G            = 0x00,
+    BMA250_OFC_TARGET_PLUS_1G       = 0x01,
+    BMA250_OFC_TARGET_MINUS_1G      = 0x02
+};
+
+#define BMA250_FIFO_DEPTH               (32)
+
+enum bma250_fifo_mode {
+    BMA250_FIFO_MODE_BYPASS         = 0x00, /* no buffering */
+    BMA250_FIFO_MODE_FIFO           = 0x40, /* stops collecting when full */
+    BMA250_FIFO_MODE_STREAM         = 0x80  /* drops the oldest when full */
+};
+
+/* Same size as a raw FIFO frame so frames can be unpacked in place */
+struct bma250_fifo_sample {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+struct bma250_fifo_batch {
+    uint8_t count;
+    //frames were lost since the previous batch
+    uint8_t overrun;
+    struct bma250_fifo_sample samples[BMA250_FIFO_DEPTH];
+};
 
 struct bma250_cfg {
     enum bma250_accel_range accel_range;
     enum bma250_accel_rate accel_rate;
+    //push data ready samples as SENSOR_TYPE_ACCEL_FIXED instead of floats
+    uint8_t fixed_output;
+    //power mode, applied last so the other registers are written in normal mode
+    enum bma250_pmu_mode pmu_mode;
+    //sleep phase length in low power mode
+    enum bma250_sleep_dur sleep_dur;
+    //fifo, bypass keeps sensor_read on the data registers
+    enum bma250_fifo_mode fifo_mode;
+    //0 leaves draining to bma250_fifo_read, else interrupt at this level, max 31
+    uint8_t fifo_watermark;
+    //1 or 2, the BMA250 INT pin carrying the watermark
+    uint8_t fifo_int_pin;
+    os_event_fn *fifo_cb;
+    //interrupts, a mask of enum bma250_int_src, latched until read
+    uint8_t int_sources;
+    //sources in this mask go to INT2, the rest to INT1
+    uint8_t int2_sources;
+    uint8_t slope_threshold;            //INT_6, LSB of the range
+    uint8_t slope_duration;             //samples-1 over threshold, max 3
+    uint8_t no_motion_threshold;        //INT_7
+    uint8_t no_motion_duration;         //INT_5 encoding, max 63
+    uint8_t tap_threshold;              //max 31
+    uint8_t tap_duration;               //double tap window code, max 7
+    uint8_t flat_theta;                 //max 63
+    os_event_fn *int_cb;
 };
 
 struct bma250 {
@@ -92,7 +163,17 @@ struct bma250 {
 };
 
 int bma250_init(struct os_dev *, void *);
+int bma250_default_cfg(struct bma250_cfg *);
 int bma250_config(struct bma250 *, struct bma250_cfg *);
+int bma250_set_pmu_mode(struct bma250 *, enum bma250_pmu_mode,
+                        enum bma250_sleep_dur);
+int bma250_calibrate(struct bma250 *, enum bma250_ofc_target,
+                     enum bma250_ofc_target, enum bma250_ofc_target);
+int bma250_fifo_read(struct bma250_fifo_sample *, uint8_t, uint8_t *,
+                     uint8_t *);
+void bma250_fifo_parse(const uint8_t *, uint8_t,
+                       struct bma250_fifo_sample *);
+int bma250_int_coalesce(uint8_t, const struct gpio_ring_coalesce *);
 
 #ifdef __cplusplus
 }
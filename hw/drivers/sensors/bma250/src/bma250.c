@@ -23,10 +23,12 @@
 
 #include "defs/error.h"
 #include "os/os.h"
+#include "os/os_cputime.h"
 #include "sysinit/sysinit.h"
-#include "hal/hal_i2c.h"
+#include "regmap/regmap.h"
 #include "sensor/sensor.h"
 #include "sensor/accel.h"
+#include "accel_fixed/accel_fixed.h"
 #include "bma250/bma250.h"
 #include "bma250_priv.h"
 
@@ -86,135 +88,222 @@ static const struct sensor_driver g_bma250_sensor_driver = {
 };
 
 /**
- * Writes a single byte to the specified register
+ * @return The event queue driver events run on, the one INT drains on
+ */
+struct os_eventq *
+bma250_evq_get(void)
+{
+    return gpio_ring_evq_get();
+}
+
+/* Data, status and FIFO registers change under us. The latch reset, soft
+ * reset and offset trigger act when written, the offsets are rewritten by
+ * the chip during compensation and a FIFO_CONFIG_1 write clears the FIFO. */
+static const uint8_t bma250_regmap_flags[BMA250_REGMAP_MAX + 1] = {
+    [BMA250_REGISTER_BGW_CHIPID]        = REGMAP_F_RO,
+    [BMA250_REGISTER_ACCD_X_LSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_X_MSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_Y_LSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_Y_MSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_Z_LSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_Z_MSB]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_ACCD_TEMP]         = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_INT_STATUS_0]      = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_INT_STATUS_1]      = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_INT_STATUS_2]      = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_INT_STATUS_3]      = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_FIFO_STATUS]       = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_BGW_SOFTRESET]     = REGMAP_F_WO | REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_INT_RST_LATCH]     = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_TRIM_NVM_CTRL]     = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_OFC_CTRL]          = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_OFC_OFFSET_X]      = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_OFC_OFFSET_Y]      = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_OFC_OFFSET_Z]      = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_FIFO_CONFIG_1]     = REGMAP_F_VOLATILE,
+    [BMA250_REGISTER_FIFO_DATA]         = REGMAP_F_RO | REGMAP_F_VOLATILE,
+};
+
+static const struct regmap_cfg bma250_regmap_cfg = {
+    .bus = {
+        .type = REGMAP_BUS_I2C,
+        .num = MYNEWT_VAL(BMA250_I2CBUS),
+        .addr = BMA250_ADDR_ACCEL,
+        .timeout = OS_TICKS_PER_SEC / 10,
+    },
+    .max_reg = BMA250_REGMAP_MAX,
+    .flags = bma250_regmap_flags,
+};
+
+static struct regmap_ent bma250_regmap_ents[BMA250_REGMAP_MAX + 1];
+static struct regmap bma250_regmap;
+
+static void
+bma250_bus_err(int rc, const char *op, uint8_t reg)
+{
+    if (rc == 0) {
+        return;
+    }
+
+    BMA250_ERR("Failed to %s 0x%02X:0x%02X\n", op, BMA250_ADDR_ACCEL, reg);
+#if MYNEWT_VAL(BMA250_STATS)
+    STATS_INC(g_bma250stats, errors);
+#endif
+}
+
+/**
+ * Writes a single byte to the specified register, skipped when the cache
+ * shows it already holds the value
  *
- * @param The I2C address to use
  * @param The register address to write to
  * @param The value to write
  *
  * @return 0 on success, non-zero error on failure.
  */
 int
-bma250_write8(uint8_t addr, uint8_t reg, uint32_t value)
+bma250_write8(uint8_t reg, uint8_t value)
 {
     int rc;
-    uint8_t payload[2] = { reg, value & 0xFF };
 
-    struct hal_i2c_master_data data_struct = {
-        .address = addr,
-        .len = 2,
-        .buffer = payload
-    };
-
-    rc = hal_i2c_master_write(MYNEWT_VAL(BMA250_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 1);
-    if (rc) {
-        BMA250_ERR("Failed to write to 0x%02X:0x%02X with value 0x%02X\n",
-                       addr, reg, value);
-#if MYNEWT_VAL(BMA250_STATS)
-        STATS_INC(g_bma250stats, errors);
-#endif
-    }
+    rc = regmap_write(&bma250_regmap, reg, value);
+    bma250_bus_err(rc, "write", reg);
 
     return rc;
 }
 
 /**
- * Reads a single byte from the specified register
+ * Reads a single byte, from the cache unless the register is volatile
  *
- * @param The I2C address to use
  * @param The register address to read from
  * @param Pointer to where the register value should be written
  *
  * @return 0 on success, non-zero error on failure.
  */
 int
-bma250_read8(uint8_t addr, uint8_t reg, uint8_t *value)
+bma250_read8(uint8_t reg, uint8_t *value)
 {
     int rc;
-    uint8_t payload;
 
-    struct hal_i2c_master_data data_struct = {
-        .address = addr,
-        .len = 1,
-        .buffer = &payload
-    };
+    rc = regmap_read(&bma250_regmap, reg, value);
+    bma250_bus_err(rc, "read", reg);
 
-    /* Register write */
-    payload = reg;
-    rc = hal_i2c_master_write(MYNEWT_VAL(BMA250_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 1);
-    if (rc) {
-        BMA250_ERR("I2C access failed at address 0x%02X\n", addr);
-#if MYNEWT_VAL(BMA250_STATS)
-        STATS_INC(g_bma250stats, errors);
-#endif
-        goto error;
-    }
+    return rc;
+}
 
-    /* Read one byte back */
-    payload = 0;
-    rc = hal_i2c_master_read(MYNEWT_VAL(BMA250_I2CBUS), &data_struct,
-                             OS_TICKS_PER_SEC / 10, 1);
-    *value = payload;
-    if (rc) {
-        BMA250_ERR("Failed to read from 0x%02X:0x%02X\n", addr, reg);
-#if MYNEWT_VAL(BMA250_STATS)
-        STATS_INC(g_bma250stats, errors);
-#endif
-    }
+/**
+ * Reads a run of bytes starting at the specified register. The BMA250
+ * auto-increments the address except on FIFO_DATA, which a long read
+ * keeps popping frames from.
+ *
+ * @param The register address to read from
+ * @param Pointer to where the register values should be written
+ * @param Number of bytes to read
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_readlen(uint8_t reg, uint8_t *buffer, uint16_t len)
+{
+    int rc;
+
+    rc = regmap_readlen(&bma250_regmap, reg, buffer, len);
+    bma250_bus_err(rc, "read", reg);
 
-error:
     return rc;
 }
 
+/**
+ * Writes a run of bytes starting at the specified register in a single
+ * auto-incrementing transfer
+ *
+ * @param The first register address to write to
+ * @param The values to write
+ * @param Number of bytes to write, at most REGMAP_BURST_MAX
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
 int
-bma250_read48(uint8_t addr, uint8_t reg, uint8_t *buffer)
+bma250_writelen(uint8_t reg, const uint8_t *buffer, uint8_t len)
 {
     int rc;
-    uint8_t payload[7] = { reg, 0, 0, 0, 0, 0, 0 };
 
-    struct hal_i2c_master_data data_struct = {
-        .address = addr,
-        .len = 1,
-        .buffer = payload
-    };
+    rc = regmap_writelen(&bma250_regmap, reg, buffer, len);
+    bma250_bus_err(rc, "write", reg);
 
-    /* Clear the supplied buffer */
-    memset(buffer, 0, 6);
+    return rc;
+}
+
+int
+bma250_read48(uint8_t reg, uint8_t *buffer)
+{
+    int rc;
 
-    /* Register write */
-    rc = hal_i2c_master_write(MYNEWT_VAL(BMA250_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 1);
+    rc = bma250_readlen(reg, buffer, 6);
     if (rc) {
-        BMA250_ERR("I2C access failed at address 0x%02X\n", addr);
-#if MYNEWT_VAL(BMA250_STATS)
-        STATS_INC(g_bma250stats, errors);
-#endif
-        goto error;
+        /* Clear the supplied buffer */
+        memset(buffer, 0, 6);
     }
 
-    /* Read six bytes back */
-    memset(payload, 0, sizeof(payload));
-    data_struct.len = 6;
-    rc = hal_i2c_master_read(MYNEWT_VAL(BMA250_I2CBUS), &data_struct,
-                             OS_TICKS_PER_SEC / 10, 1);
+    return rc;
+}
 
-    if (rc) {
-        BMA250_ERR("Failed to read from 0x%02X:0x%02X\n", addr, reg);
-#if MYNEWT_VAL(BMA250_STATS)
-        STATS_INC(g_bma250stats, errors);
-#endif
-        goto error;
-    }
+/**
+ * Sets bits in a single byte of the specified register, no bus access
+ * when they are already set
+ *
+ * @param The register address to write to
+ * @param The bits to set
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_set8(uint8_t reg, uint8_t value)
+{
+    int rc;
+
+    rc = regmap_update_bits(&bma250_regmap, reg, value, value);
+    bma250_bus_err(rc, "update", reg);
+
+    return rc;
+}
+
+/**
+ * Clears bits in a single byte of the specified register, no bus access
+ * when they are already clear
+ *
+ * @param The register address to write to
+ * @param The bits to clear
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_clear8(uint8_t reg, uint8_t value)
+{
+    int rc;
+
+    rc = regmap_update_bits(&bma250_regmap, reg, value, 0);
+    bma250_bus_err(rc, "update", reg);
 
-    /* Copy the I2C results into the supplied buffer */
-    memcpy(buffer, payload, 6);
+    return rc;
+}
 
-    /* ToDo: Log raw reads */
-    // console_printf("0x%04X\n", (uint16_t)payload[0] | ((uint16_t)payload[1] << 8));
+/**
+ * Applies a register table, changed registers are written in address
+ * order with consecutive ones merged into one burst
+ *
+ * @param The steps to apply
+ * @param Number of steps
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_seq_apply(const struct regmap_seq *seq, int count)
+{
+    int rc;
+
+    rc = regmap_seq_apply(&bma250_regmap, seq, count);
+    bma250_bus_err(rc, "apply", seq[0].reg);
 
-error:
     return rc;
 }
 
@@ -241,6 +330,11 @@ bma250_init(struct os_dev *dev, void *arg)
 
     sensor = &lsm->sensor;
 
+    rc = regmap_init(&bma250_regmap, &bma250_regmap_cfg, bma250_regmap_ents);
+    if (rc != 0) {
+        goto err;
+    }
+
 #if MYNEWT_VAL(BMA250_STATS)
     /* Initialise the stats entry */
     rc = stats_init(
@@ -253,13 +347,19 @@ bma250_init(struct os_dev *dev, void *arg)
     SYSINIT_PANIC_ASSERT(rc == 0);
 #endif
 
+#if MYNEWT_VAL(BMA250_OFC_CONF)
+    rc = bma250_ofc_init();
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+
     rc = sensor_init(sensor, dev);
     if (rc != 0) {
         goto err;
     }
 
     /* Add the accelerometer driver */
-    rc = sensor_set_driver(sensor, SENSOR_TYPE_ACCELEROMETER,
+    rc = sensor_set_driver(sensor,
+            SENSOR_TYPE_ACCELEROMETER | SENSOR_TYPE_ACCEL_FIXED,
             (struct sensor_driver *) &g_bma250_sensor_driver);
     if (rc != 0) {
         goto err;
@@ -275,26 +375,120 @@ err:
     return (rc);
 }
 
+int
+bma250_default_cfg(struct bma250_cfg *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+
+    cfg->accel_range = BMA250_ACCEL_RANGE_2;
+    cfg->accel_rate = BMA250_ACCEL_RATE_12500;
+    cfg->pmu_mode = BMA250_PMU_MODE_NORMAL;
+    cfg->sleep_dur = BMA250_SLEEP_DUR_0_5;
+    cfg->fifo_mode = BMA250_FIFO_MODE_BYPASS;
+    cfg->fifo_int_pin = 1;
+    /* Interrupt thresholds at the chip reset values */
+    cfg->slope_threshold = 0x14;
+    cfg->no_motion_threshold = 0x14;
+    cfg->tap_threshold = 0x0A;
+    cfg->tap_duration = 0x04;
+    cfg->flat_theta = 0x08;
+
+    return 0;
+}
+
+/**
+ * Switches the power mode with a single PMU_LPW write, skipped when the
+ * chip is already in the requested mode
+ *
+ * @param The device object associated with this accellerometer
+ * @param The power mode
+ * @param The sleep phase length, only used in low power mode
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_set_pmu_mode(struct bma250 *lsm, enum bma250_pmu_mode mode,
+                    enum bma250_sleep_dur dur)
+{
+    uint8_t lpw;
+    uint8_t from;
+    int rc;
+
+    switch (mode) {
+    case BMA250_PMU_MODE_NORMAL:
+    case BMA250_PMU_MODE_SUSPEND:
+        lpw = mode;
+        break;
+    case BMA250_PMU_MODE_LOW_POWER:
+        lpw = mode | (dur & BMA250_REGISTER_PMU_LPW_SLEEP_DUR);
+        break;
+    default:
+        rc = SYS_EINVAL;
+        goto err;
+    }
+
+    /* The register cache knows the mode, unless a write failed */
+    rc = bma250_read8(BMA250_REGISTER_PMU_LPW, &from);
+    if (rc == 0 && lpw == from) {
+        return (0);
+    }
+
+    rc = bma250_write8(BMA250_REGISTER_PMU_LPW, lpw);
+    if (rc != 0) {
+        goto err;
+    }
+
+    if (mode == BMA250_PMU_MODE_NORMAL) {
+        os_cputime_delay_usecs(BMA250_PMU_WAKEUP_US);
+    }
+
+    return (0);
+err:
+    return (rc);
+}
+
 int
 bma250_config(struct bma250 *lsm, struct bma250_cfg *cfg)
 {
+    const struct regmap_seq seq[] = {
+        { BMA250_REGISTER_PMU_RANGE, cfg->accel_range,
+          BMA250_REGISTER_PMU_RANGE_RANGE },
+        { BMA250_REGISTER_PMU_BW, cfg->accel_rate,
+          BMA250_REGISTER_PMU_BW_BW },
+    };
     int rc;
 
     /* Overwrite the configuration data. */
     memcpy(&lsm->cfg, cfg, sizeof(*cfg));
 
-    /* Set accel data rate and enable XYZ output */
-    rc = bma250_write8(BMA250_ADDR_ACCEL,
-        BMA250_REGISTER_PMU_BW,
-        lsm->cfg.accel_rate | 0x1F);
+    /* Suspend and low power need 450us between writes, configure awake */
+    rc = bma250_set_pmu_mode(lsm, BMA250_PMU_MODE_NORMAL, 0);
+    if (rc != 0) {
+        goto err;
+    }
+
+    /* Accel scale and data rate, one burst */
+    rc = bma250_seq_apply(seq, sizeof(seq) / sizeof(seq[0]));
     if (rc != 0) {
         goto err;
     }
 
-    /* Set accel scale */
-    rc = bma250_write8(BMA250_ADDR_ACCEL,
-        BMA250_REGISTER_PMU_RANGE,
-        lsm->cfg.accel_range | 0x0F);
+    rc = bma250_fifo_configure(&lsm->cfg);
+    if (rc != 0) {
+        goto err;
+    }
+
+    rc = bma250_int_configure(lsm);
+    if (rc != 0) {
+        goto err;
+    }
+
+    rc = bma250_ofc_restore();
+    if (rc != 0) {
+        goto err;
+    }
+
+    rc = bma250_set_pmu_mode(lsm, lsm->cfg.pmu_mode, lsm->cfg.sleep_dur);
     if (rc != 0) {
         goto err;
     }
@@ -315,13 +509,15 @@ bma250_sensor_read(struct sensor *sensor, sensor_type_t type,
 {
     struct bma250 *lsm;
     struct sensor_accel_data sad;
+    struct accel_fixed_data afd;
+    void *data;
     int rc;
-    int16_t x, y, z;
-    float mg_lsb;
     uint8_t payload[6];
 
-    /* If the read isn't looking for accel data, don't do anything. */
-    if (!(type & SENSOR_TYPE_ACCELEROMETER)) {
+    /* If the read isn't looking for one kind of accel data, don't do
+     * anything, the data function can't tell the two apart */
+    if (type != SENSOR_TYPE_ACCELEROMETER &&
+        type != SENSOR_TYPE_ACCEL_FIXED) {
         rc = SYS_EINVAL;
         goto err;
     }
@@ -329,64 +525,65 @@ bma250_sensor_read(struct sensor *sensor, sensor_type_t type,
     lsm = (struct bma250 *) SENSOR_GET_DEVICE(sensor);
 
     /* Get a new accelerometer sample */
-    if (type & SENSOR_TYPE_ACCELEROMETER) {
-        x = y = z = 0;
-        rc = bma250_read48(BMA250_ADDR_ACCEL,
-                            BMA250_REGISTER_ACCD_X_LSB,
-                            payload);
+    if (type & (SENSOR_TYPE_ACCELEROMETER | SENSOR_TYPE_ACCEL_FIXED)) {
+        rc = bma250_read48(BMA250_REGISTER_ACCD_X_LSB, payload);
         if (rc != 0) {
             goto err;
         }
 
         /* Shift 10-bit left-aligned accel values into 16-bit int */
-        x = ((int16_t)(payload[0] | (payload[1] << 8))) >> 6;
-        y = ((int16_t)(payload[2] | (payload[3] << 8))) >> 6;
-        z = ((int16_t)(payload[4] | (payload[5] << 8))) >> 6;
+        afd.afd_raw_x = ((int16_t)(payload[0] | (payload[1] << 8))) >> 6;
+        afd.afd_raw_y = ((int16_t)(payload[2] | (payload[3] << 8))) >> 6;
+        afd.afd_raw_z = ((int16_t)(payload[4] | (payload[5] << 8))) >> 6;
 
-        /* Determine mg per lsb based on range */
+        /* Determine mg per lsb based on range, the full scale span over
+         * 1024 counts, in Q10 that is the span in mg */
         switch(lsm->cfg.accel_range) {
             case BMA250_ACCEL_RANGE_2:
 #if MYNEWT_VAL(BMA250_STATS)
                 STATS_INC(g_bma250stats, samples_acc_2g);
 #endif
-                mg_lsb = 0.001F;
+                afd.afd_scale = 4000;
                 break;
             case BMA250_ACCEL_RANGE_4:
 #if MYNEWT_VAL(BMA250_STATS)
                 STATS_INC(g_bma250stats, samples_acc_4g);
 #endif
-                mg_lsb = 0.002F;
+                afd.afd_scale = 8000;
                 break;
             case BMA250_ACCEL_RANGE_8:
 #if MYNEWT_VAL(BMA250_STATS)
                 STATS_INC(g_bma250stats, samples_acc_8g);
 #endif
-                mg_lsb = 0.004F;
+                afd.afd_scale = 16000;
                 break;
             case BMA250_ACCEL_RANGE_16:
 #if MYNEWT_VAL(BMA250_STATS)
                 STATS_INC(g_bma250stats, samples_acc_16g);
 #endif
-                mg_lsb = 0.012F;
+                afd.afd_scale = 32000;
                 break;
             default:
                 BMA250_ERR("Unknown accel range: 0x%02X. Assuming +/-2G.\n",
                     lsm->cfg.accel_range);
-                mg_lsb = 0.001F;
+                afd.afd_scale = 4000;
                 break;
         }
 
-        /* Convert from mg to Earth gravity in m/s^2 */
-        sad.sad_x = (float)x * mg_lsb * 9.80665F;
-        sad.sad_y = (float)y * mg_lsb * 9.80665F;
-        sad.sad_z = (float)z * mg_lsb * 9.80665F;
+        afd.afd_x = accel_fixed_mg(afd.afd_raw_x, afd.afd_scale);
+        afd.afd_y = accel_fixed_mg(afd.afd_raw_y, afd.afd_scale);
+        afd.afd_z = accel_fixed_mg(afd.afd_raw_z, afd.afd_scale);
 
-        sad.sad_x_is_valid = 1;
-        sad.sad_y_is_valid = 1;
-        sad.sad_z_is_valid = 1;
+        if (type == SENSOR_TYPE_ACCEL_FIXED) {
+            data = &afd;
+        } else {
+            /* Convert from mg to Earth gravity in m/s^2 */
+            accel_fixed_to_float(&afd, &sad);
+            data = &sad;
+        }
 
         /* Call data function */
-        rc = data_func(sensor, data_arg, &sad);
+        rc = data_func(sensor, data_arg, data);
         if (rc != 0) {
             goto err;
         }
@@ -403,13 +600,15 @@ bma250_sensor_get_config(struct sensor *sensor, sensor_type_t type,
 {
     int rc;
 
-    if ((type != SENSOR_TYPE_ACCELEROMETER)) {
+    if (type == SENSOR_TYPE_ACCELEROMETER) {
+        cfg->sc_valtype = SENSOR_VALUE_TYPE_FLOAT_TRIPLET;
+    } else if (type == SENSOR_TYPE_ACCEL_FIXED) {
+        cfg->sc_valtype = SENSOR_VALUE_TYPE_INT32_TRIPLET;
+    } else {
         rc = SYS_EINVAL;
         goto err;
     }
 
-    cfg->sc_valtype = SENSOR_VALUE_TYPE_FLOAT_TRIPLET;
-
     return (0);
 err:
     return (rc);
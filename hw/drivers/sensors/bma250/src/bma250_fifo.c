@@ -0,0 +1,244 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bma250/bma250.h"
+#include "bma250_priv.h"
+
+/*
+ * In FIFO and stream modes the BMA250 queues up to BMA250_FIFO_DEPTH XYZ
+ * frames. FIFO_DATA does not auto-increment, so one long read pops as
+ * many frames as it has room for; on the 100kHz bus that costs one
+ * address phase per batch instead of one per sample.
+ *
+ * The watermark interrupt is routed by the interrupt engine, which hands
+ * over the FIFO_STATUS it read along with INT_STATUS.
+ */
+
+static struct bma250_cfg *bma250_fifo_cfg;
+
+static struct bma250_fifo_batch fifo_batch;
+static struct os_event fifo_batch_ev = {
+    .ev_arg = &fifo_batch,
+};
+
+/**
+ * Unpacks XYZ FIFO frames into samples. raw may point at samples itself,
+ * each frame is read fully before its sample is written.
+ *
+ * @param The raw frames as read from FIFO_DATA
+ * @param Number of frames
+ * @param Where the unpacked samples should be written
+ */
+void
+bma250_fifo_parse(const uint8_t *raw, uint8_t count,
+                  struct bma250_fifo_sample *samples)
+{
+    int16_t x, y, z;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        /* Shift 10-bit left-aligned accel values into 16-bit int */
+        x = ((int16_t)(raw[0] | (raw[1] << 8))) >> 6;
+        y = ((int16_t)(raw[2] | (raw[3] << 8))) >> 6;
+        z = ((int16_t)(raw[4] | (raw[5] << 8))) >> 6;
+
+        samples[i].x = x;
+        samples[i].y = y;
+        samples[i].z = z;
+        raw += BMA250_FIFO_FRAME_LEN;
+    }
+}
+
+static int
+bma250_fifo_pop(uint8_t status, struct bma250_fifo_sample *samples,
+                uint8_t max, uint8_t *count)
+{
+    uint8_t frames;
+    int rc;
+
+    *count = 0;
+
+    frames = status & BMA250_REGISTER_FIFO_STATUS_FRAMES;
+    if (frames > max) {
+        frames = max;
+    }
+    if (frames == 0) {
+        return 0;
+    }
+
+    /* Read straight into the caller buffer and unpack in place */
+    rc = bma250_readlen(BMA250_REGISTER_FIFO_DATA,
+                        (uint8_t *)samples, frames * BMA250_FIFO_FRAME_LEN);
+    if (rc != 0) {
+        return rc;
+    }
+
+    bma250_fifo_parse((uint8_t *)samples, frames, samples);
+    *count = frames;
+
+    return 0;
+}
+
+/**
+ * Drains up to max frames from the FIFO in a single burst
+ *
+ * @param Where the samples should be written
+ * @param Capacity of samples
+ * @param Pointer to where the number of samples read should be written
+ * @param Pointer to where the overrun flag should be written, may be NULL
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_fifo_read(struct bma250_fifo_sample *samples, uint8_t max,
+                 uint8_t *count, uint8_t *overrun)
+{
+    uint8_t status;
+    int rc;
+
+    *count = 0;
+
+    rc = bma250_read8(BMA250_REGISTER_FIFO_STATUS,
+                      &status);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (overrun) {
+        *overrun = !!(status & BMA250_REGISTER_FIFO_STATUS_OVERRUN);
+    }
+
+    rc = bma250_fifo_pop(status, samples, max, count);
+    if (rc != 0) {
+        goto error;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+/**
+ * Drains the FIFO into the batch and posts it to fifo_cb, called by the
+ * interrupt engine on a watermark
+ *
+ * @param FIFO_STATUS as read with INT_STATUS
+ */
+void
+bma250_fifo_drain(uint8_t status)
+{
+    struct bma250_cfg *cfg;
+    uint8_t overrun;
+    uint8_t count;
+    int rc;
+
+    cfg = bma250_fifo_cfg;
+    if (cfg == NULL) {
+        return;
+    }
+
+    rc = bma250_fifo_pop(status, fifo_batch.samples, BMA250_FIFO_DEPTH,
+                         &count);
+    if (rc) {
+        return;
+    }
+
+    overrun = !!(status & BMA250_REGISTER_FIFO_STATUS_OVERRUN);
+    if (overrun) {
+        /* Only a FIFO_CONFIG_1 write clears the overrun flag */
+        rc = bma250_write8(BMA250_REGISTER_FIFO_CONFIG_1,
+                           cfg->fifo_mode | BMA250_REGISTER_FIFO_CONFIG_1_XYZ);
+        if (rc) {
+            return;
+        }
+    }
+
+    if (count) {
+        fifo_batch.count = count;
+        fifo_batch.overrun = overrun;
+        if (fifo_batch_ev.ev_cb) {
+            os_eventq_put(bma250_evq_get(), &fifo_batch_ev);
+        }
+    }
+}
+
+/**
+ * Configures the FIFO mode and watermark from cfg, the interrupt engine
+ * routes the watermark to the INT pin chosen by fifo_int_pin
+ *
+ * @param The configuration, must stay valid while the FIFO runs
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_fifo_configure(struct bma250_cfg *cfg)
+{
+    int rc;
+
+    bma250_fifo_cfg = NULL;
+
+    switch (cfg->fifo_mode) {
+    case BMA250_FIFO_MODE_BYPASS:
+    case BMA250_FIFO_MODE_FIFO:
+    case BMA250_FIFO_MODE_STREAM:
+        break;
+    default:
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    if (cfg->fifo_watermark >= BMA250_FIFO_DEPTH) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    /* Writing FIFO_CONFIG_1 empties the FIFO and clears the overrun */
+    rc = bma250_write8(BMA250_REGISTER_FIFO_CONFIG_1,
+                       cfg->fifo_mode | BMA250_REGISTER_FIFO_CONFIG_1_XYZ);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (cfg->fifo_mode == BMA250_FIFO_MODE_BYPASS ||
+        cfg->fifo_watermark == 0) {
+        goto done;
+    }
+
+    rc = bma250_write8(BMA250_REGISTER_FIFO_CONFIG_0,
+                       cfg->fifo_watermark &
+                       BMA250_REGISTER_FIFO_CONFIG_0_WATER_MARK);
+    if (rc != 0) {
+        goto error;
+    }
+
+    fifo_batch_ev.ev_cb = cfg->fifo_cb;
+    bma250_fifo_cfg = cfg;
+
+done:
+    return 0;
+error:
+    return rc;
+}
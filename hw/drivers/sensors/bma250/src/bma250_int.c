@@ -0,0 +1,424 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "hal/hal_gpio.h"
+#include "gpio_ring/gpio_ring.h"
+#include "sensor/sensor.h"
+#include "accel_fixed/accel_fixed.h"
+#include "bma250/bma250.h"
+#include "bma250_priv.h"
+
+/*
+ * Interrupt engine. The detectors run on the BMA250 and latch their
+ * status, so the nRF51 only wakes for an edge. Each INT pin feeds its
+ * edges through the GPIO ring, and every edge reads INT_STATUS_0..3 and
+ * FIFO_STATUS in a single burst, re-arms the latch and dispatches: a
+ * watermark drains the FIFO, data ready runs a sensor_read and the
+ * detectors are reported through int_cb. A pin carrying only data ready
+ * skips the burst.
+ */
+
+#define BMA250_INT_BURST_LEN \
+    (BMA250_REGISTER_FIFO_STATUS - BMA250_REGISTER_INT_STATUS_0 + 1)
+
+#define BMA250_INT_AT(burst, reg) \
+    ((burst)[(reg) - BMA250_REGISTER_INT_STATUS_0])
+
+/* Where each source is enabled, routed and reported */
+struct bma250_int_route {
+    uint8_t src;
+    uint8_t en_reg;
+    uint8_t en_bits;
+    uint8_t int1_reg;
+    uint8_t int1_bits;
+    uint8_t int2_reg;
+    uint8_t int2_bits;
+    uint8_t status_reg;
+    uint8_t status_bits;
+};
+
+static const struct bma250_int_route bma250_int_routes[] = {
+    {
+        BMA250_INT_SLOPE,
+        BMA250_REGISTER_INT_EN_0, BMA250_REGISTER_INT_EN_0_SLOPE_XYZ,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_SLOPE,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_SLOPE,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_SLOPE
+    },
+    {
+        BMA250_INT_NO_MOTION,
+        BMA250_REGISTER_INT_EN_2, BMA250_REGISTER_INT_EN_2_SLO_NO_MOT_SEL |
+                                  BMA250_REGISTER_INT_EN_2_SLO_NO_MOT_XYZ,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_SLO_NO_MOT,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_SLO_NO_MOT,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_SLO_NO_MOT
+    },
+    {
+        BMA250_INT_TAP,
+        BMA250_REGISTER_INT_EN_0, BMA250_REGISTER_INT_EN_0_S_TAP,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_S_TAP,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_S_TAP,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_S_TAP
+    },
+    {
+        BMA250_INT_DOUBLE_TAP,
+        BMA250_REGISTER_INT_EN_0, BMA250_REGISTER_INT_EN_0_D_TAP,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_D_TAP,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_D_TAP,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_D_TAP
+    },
+    {
+        BMA250_INT_ORIENT,
+        BMA250_REGISTER_INT_EN_0, BMA250_REGISTER_INT_EN_0_ORIENT,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_ORIENT,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_ORIENT,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_ORIENT
+    },
+    {
+        BMA250_INT_FLAT,
+        BMA250_REGISTER_INT_EN_0, BMA250_REGISTER_INT_EN_0_FLAT,
+        BMA250_REGISTER_INT_MAP_0, BMA250_REGISTER_INT_MAP_0_FLAT,
+        BMA250_REGISTER_INT_MAP_2, BMA250_REGISTER_INT_MAP_0_FLAT,
+        BMA250_REGISTER_INT_STATUS_0, BMA250_REGISTER_INT_STATUS_0_FLAT
+    },
+    {
+        BMA250_INT_DATA,
+        BMA250_REGISTER_INT_EN_1, BMA250_REGISTER_INT_EN_1_DATA,
+        BMA250_REGISTER_INT_MAP_1, BMA250_REGISTER_INT_MAP_1_INT1_DATA,
+        BMA250_REGISTER_INT_MAP_1, BMA250_REGISTER_INT_MAP_1_INT2_DATA,
+        BMA250_REGISTER_INT_STATUS_1, BMA250_REGISTER_INT_STATUS_1_DATA
+    },
+};
+
+#define BMA250_INT_ROUTES \
+    (sizeof(bma250_int_routes) / sizeof(bma250_int_routes[0]))
+
+struct bma250_int_pin {
+    int gpio;
+    uint8_t sources;                    /* enum bma250_int_src routed here */
+    uint8_t fifo;                       /* carries the FIFO watermark */
+    struct gpio_ring_pin gp;
+};
+
+static struct bma250_int_pin bma250_int_pins[2] = {
+    { .gpio = MYNEWT_VAL(BMA250_INT1_PIN) },
+    { .gpio = MYNEWT_VAL(BMA250_INT2_PIN) },
+};
+
+static struct bma250 *bma250_int_dev;
+
+static struct bma250_int_event int_event;
+static struct os_event int_event_ev = {
+    .ev_arg = &int_event,
+};
+
+static void
+bma250_int_report(struct bma250_int_pin *ip, const uint8_t *burst,
+                  uint32_t ts)
+{
+    const struct bma250_int_route *route;
+    uint8_t status3;
+    uint8_t fired;
+    int i;
+
+    fired = 0;
+    for (i = 0; i < BMA250_INT_ROUTES; i++) {
+        route = &bma250_int_routes[i];
+        if (route->src == BMA250_INT_DATA) {
+            continue;
+        }
+        if ((ip->sources & route->src) &&
+            (BMA250_INT_AT(burst, route->status_reg) & route->status_bits)) {
+            fired |= route->src;
+        }
+    }
+    if (fired == 0) {
+        return;
+    }
+
+    status3 = BMA250_INT_AT(burst, BMA250_REGISTER_INT_STATUS_3);
+
+    int_event.sources = fired;
+    int_event.orient = (status3 & BMA250_REGISTER_INT_STATUS_3_ORIENT) >>
+                       BMA250_REGISTER_INT_STATUS_3_ORIENT_SHIFT;
+    int_event.face_down = !!(status3 & BMA250_REGISTER_INT_STATUS_3_FACE_DOWN);
+    int_event.flat = !!(status3 & BMA250_REGISTER_INT_STATUS_3_FLAT);
+    memcpy(int_event.status, burst, sizeof(int_event.status));
+    int_event.ts = ts;
+
+    if (int_event_ev.ev_cb) {
+        os_eventq_put(bma250_evq_get(), &int_event_ev);
+    }
+}
+
+static void
+bma250_int_edge(struct gpio_ring_pin *gp, int level, uint32_t ts)
+{
+    struct bma250_int_pin *ip;
+    struct bma250 *lsm;
+    uint8_t burst[BMA250_INT_BURST_LEN];
+    int rc;
+
+    ip = gp->arg;
+    lsm = bma250_int_dev;
+    if (lsm == NULL) {
+        return;
+    }
+
+    if (ip->fifo || (ip->sources & ~BMA250_INT_DATA)) {
+        rc = bma250_readlen(BMA250_REGISTER_INT_STATUS_0,
+                            burst, sizeof(burst));
+        if (rc) {
+            return;
+        }
+
+        /* Everything latched is in the burst, let new events through */
+        rc = bma250_write8(BMA250_REGISTER_INT_RST_LATCH,
+                           BMA250_REGISTER_INT_RST_LATCH_RESET_INT |
+                           BMA250_REGISTER_INT_RST_LATCH_LATCHED);
+        if (rc) {
+            return;
+        }
+
+        if (ip->fifo &&
+            (BMA250_INT_AT(burst, BMA250_REGISTER_INT_STATUS_1) &
+             (BMA250_REGISTER_INT_STATUS_1_FWM |
+              BMA250_REGISTER_INT_STATUS_1_FFULL))) {
+            bma250_fifo_drain(BMA250_INT_AT(burst,
+                                            BMA250_REGISTER_FIFO_STATUS));
+        }
+
+        bma250_int_report(ip, burst, ts);
+    }
+
+    /* New data is never latched, the edge itself is the event */
+    if (ip->sources & BMA250_INT_DATA) {
+        lsm->last_read_time = os_time_get();
+        sensor_read(&lsm->sensor, lsm->cfg.fixed_output ?
+                    SENSOR_TYPE_ACCEL_FIXED : SENSOR_TYPE_ACCELEROMETER,
+                    NULL, NULL, OS_TIMEOUT_NEVER);
+    }
+
+    /* The watermark is a level, frames arriving during the drain can
+     * hold it without a new edge */
+    if (hal_gpio_read(ip->gpio)) {
+        gpio_ring_inject(gp);
+    }
+}
+
+/* Thresholds of disabled sources are written too, the sources stay gated
+ * by INT_EN and a whole table goes out as two bursts */
+static int
+bma250_int_thresholds(struct bma250_cfg *cfg)
+{
+    const struct regmap_seq seq[] = {
+        { BMA250_REGISTER_INT_5,
+          (cfg->no_motion_duration <<
+           BMA250_REGISTER_INT_5_SLO_NO_MOT_DUR_SHIFT) |
+          (cfg->slope_duration & BMA250_REGISTER_INT_5_SLOPE_DUR), 0xFF },
+        { BMA250_REGISTER_INT_6, cfg->slope_threshold, 0xFF },
+        { BMA250_REGISTER_INT_7, cfg->no_motion_threshold, 0xFF },
+        /* Quiet 30ms, shock 50ms */
+        { BMA250_REGISTER_INT_8,
+          cfg->tap_duration & BMA250_REGISTER_INT_8_TAP_DUR, 0xFF },
+        /* Two samples after the threshold crossing */
+        { BMA250_REGISTER_INT_9,
+          cfg->tap_threshold & BMA250_REGISTER_INT_9_TAP_TH, 0xFF },
+        { BMA250_REGISTER_INT_C,
+          cfg->flat_theta & BMA250_REGISTER_INT_C_FLAT_THETA, 0xFF },
+    };
+
+    return bma250_seq_apply(seq, sizeof(seq) / sizeof(seq[0]));
+}
+
+/**
+ * Programs the enabled interrupt sources, their thresholds and their
+ * routing to INT1/INT2 from the device configuration, and arms the GPIO
+ * of every pin in use
+ *
+ * @param The device object associated with this accellerometer
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_int_configure(struct bma250 *lsm)
+{
+    const struct bma250_int_route *route;
+    struct bma250_int_pin *ip;
+    struct bma250_cfg *cfg;
+    uint8_t en[3];
+    uint8_t map[3];
+    int i;
+    int rc;
+
+    cfg = &lsm->cfg;
+    bma250_int_dev = NULL;
+
+    for (i = 0; i < 2; i++) {
+        ip = &bma250_int_pins[i];
+        gpio_ring_pin_release(&ip->gp);
+        ip->sources = 0;
+        ip->fifo = 0;
+    }
+
+    /* Quiet the pins while the thresholds change */
+    for (i = 0; i < 3; i++) {
+        rc = bma250_write8(BMA250_REGISTER_INT_EN_0 + i, 0);
+        if (rc != 0) {
+            goto error;
+        }
+    }
+
+    memset(en, 0, sizeof(en));
+    memset(map, 0, sizeof(map));
+
+    for (i = 0; i < BMA250_INT_ROUTES; i++) {
+        route = &bma250_int_routes[i];
+        if (!(cfg->int_sources & route->src)) {
+            continue;
+        }
+
+        en[route->en_reg - BMA250_REGISTER_INT_EN_0] |= route->en_bits;
+        if (cfg->int2_sources & route->src) {
+            map[route->int2_reg - BMA250_REGISTER_INT_MAP_0] |=
+                route->int2_bits;
+            bma250_int_pins[1].sources |= route->src;
+        } else {
+            map[route->int1_reg - BMA250_REGISTER_INT_MAP_0] |=
+                route->int1_bits;
+            bma250_int_pins[0].sources |= route->src;
+        }
+    }
+
+    if (cfg->fifo_mode != BMA250_FIFO_MODE_BYPASS && cfg->fifo_watermark) {
+        en[1] |= BMA250_REGISTER_INT_EN_1_FWM;
+        switch (cfg->fifo_int_pin) {
+        case 1:
+            map[1] |= BMA250_REGISTER_INT_MAP_1_INT1_FWM;
+            break;
+        case 2:
+            map[1] |= BMA250_REGISTER_INT_MAP_1_INT2_FWM;
+            break;
+        default:
+            rc = SYS_EINVAL;
+            goto error;
+        }
+        bma250_int_pins[cfg->fifo_int_pin - 1].fifo = 1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        ip = &bma250_int_pins[i];
+        if ((ip->sources || ip->fifo) && ip->gpio < 0) {
+            rc = SYS_EINVAL;
+            goto error;
+        }
+    }
+
+    rc = bma250_int_thresholds(cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    /* Active high push-pull, both pins rise on an event */
+    rc = bma250_write8(BMA250_REGISTER_INT_OUT_CTRL,
+                       BMA250_REGISTER_INT_OUT_CTRL_INT1_LVL |
+                       BMA250_REGISTER_INT_OUT_CTRL_INT2_LVL);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = bma250_write8(BMA250_REGISTER_INT_RST_LATCH,
+                       BMA250_REGISTER_INT_RST_LATCH_RESET_INT |
+                       BMA250_REGISTER_INT_RST_LATCH_LATCHED);
+    if (rc != 0) {
+        goto error;
+    }
+
+    for (i = 0; i < 3; i++) {
+        rc = bma250_write8(BMA250_REGISTER_INT_MAP_0 + i,
+                           map[i]);
+        if (rc != 0) {
+            goto error;
+        }
+    }
+
+    int_event_ev.ev_cb = cfg->int_cb;
+    bma250_int_dev = lsm;
+
+    for (i = 0; i < 2; i++) {
+        ip = &bma250_int_pins[i];
+        if (!ip->sources && !ip->fifo) {
+            continue;
+        }
+
+        rc = gpio_ring_pin_init(&ip->gp, ip->gpio, HAL_GPIO_TRIG_RISING,
+                                HAL_GPIO_PULL_NONE, bma250_int_edge, ip);
+        if (rc != 0) {
+            goto error;
+        }
+    }
+
+    for (i = 0; i < 3; i++) {
+        rc = bma250_write8(BMA250_REGISTER_INT_EN_0 + i,
+                           en[i]);
+        if (rc != 0) {
+            goto error;
+        }
+    }
+
+    /* A pin already high has no edge coming */
+    for (i = 0; i < 2; i++) {
+        ip = &bma250_int_pins[i];
+        if (ip->gp.fn && hal_gpio_read(ip->gpio)) {
+            gpio_ring_inject(&ip->gp);
+        }
+    }
+
+    return 0;
+error:
+    bma250_int_dev = NULL;
+    return rc;
+}
+
+/**
+ * Sets the edge coalescing of an INT pin, kept across bma250_config()
+ *
+ * @param The INT pin, 1 or 2
+ * @param The coalescing, all zero passes every edge
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_int_coalesce(uint8_t pin, const struct gpio_ring_coalesce *co)
+{
+    if (pin != 1 && pin != 2) {
+        return SYS_EINVAL;
+    }
+
+    gpio_ring_pin_coalesce(&bma250_int_pins[pin - 1].gp, co);
+
+    return 0;
+}
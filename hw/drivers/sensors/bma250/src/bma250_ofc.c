@@ -0,0 +1,334 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bma250/bma250.h"
+#include "bma250_priv.h"
+
+#if MYNEWT_VAL(BMA250_OFC_CONF)
+#include "config/config.h"
+#endif
+
+/*
+ * Fast offset compensation. The BMA250 averages its own output on one
+ * axis at a time and loads OFC_OFFSET_X/Y/Z so the data registers and
+ * the FIFO already read the requested target. The offsets live in
+ * volatile registers; they are kept here, saved as bma250/ofc_x..z
+ * when BMA250_OFC_CONF is on, and written back in one burst by every
+ * bma250_config() and by conf_load() once the chip is configured.
+ */
+
+#define BMA250_OFC_AXES         (3)
+#define BMA250_OFC_TIMEOUT      (OS_TICKS_PER_SEC / 2)
+
+static int8_t bma250_ofc_offset[BMA250_OFC_AXES];
+static uint8_t bma250_ofc_valid;
+
+/* Set by the first bma250_config(), offsets loaded later go straight out */
+static uint8_t bma250_ofc_chip_up;
+
+#if MYNEWT_VAL(BMA250_OFC_CONF)
+static char *bma250_ofc_conf_get(int argc, char **argv, char *val,
+                                 int val_len_max);
+static int bma250_ofc_conf_set(int argc, char **argv, char *val);
+static int bma250_ofc_conf_commit(void);
+static int bma250_ofc_conf_export(void (*func)(char *name, char *val),
+                                  enum conf_export_tgt tgt);
+
+static struct conf_handler bma250_ofc_conf_handler = {
+    .ch_name = "bma250",
+    .ch_get = bma250_ofc_conf_get,
+    .ch_set = bma250_ofc_conf_set,
+    .ch_commit = bma250_ofc_conf_commit,
+    .ch_export = bma250_ofc_conf_export
+};
+
+static int
+bma250_ofc_conf_axis(char *name)
+{
+    if (strlen(name) != 5 || strncmp(name, "ofc_", 4) != 0 ||
+        name[4] < 'x' || name[4] > 'z') {
+        return -1;
+    }
+
+    return name[4] - 'x';
+}
+
+static char *
+bma250_ofc_conf_get(int argc, char **argv, char *val, int val_len_max)
+{
+    int axis;
+
+    if (argc != 1) {
+        return NULL;
+    }
+
+    axis = bma250_ofc_conf_axis(argv[0]);
+    if (axis < 0) {
+        return NULL;
+    }
+
+    return conf_str_from_value(CONF_INT8, &bma250_ofc_offset[axis], val,
+                               val_len_max);
+}
+
+static int
+bma250_ofc_conf_set(int argc, char **argv, char *val)
+{
+    int axis;
+    int rc;
+
+    if (argc != 1) {
+        return SYS_ENOENT;
+    }
+
+    axis = bma250_ofc_conf_axis(argv[0]);
+    if (axis < 0) {
+        return SYS_ENOENT;
+    }
+
+    rc = CONF_VALUE_SET(val, CONF_INT8, bma250_ofc_offset[axis]);
+    if (rc) {
+        return rc;
+    }
+    bma250_ofc_valid |= 1 << axis;
+
+    return 0;
+}
+
+static int
+bma250_ofc_conf_commit(void)
+{
+    if (!bma250_ofc_chip_up) {
+        return 0;
+    }
+
+    return bma250_ofc_restore();
+}
+
+static int
+bma250_ofc_conf_export(void (*func)(char *name, char *val),
+                       enum conf_export_tgt tgt)
+{
+    char name[] = "bma250/ofc_x";
+    char buf[8];
+    int axis;
+
+    if (bma250_ofc_valid != (1 << BMA250_OFC_AXES) - 1) {
+        return 0;
+    }
+
+    for (axis = 0; axis < BMA250_OFC_AXES; axis++) {
+        name[sizeof(name) - 2] = 'x' + axis;
+        conf_str_from_value(CONF_INT8, &bma250_ofc_offset[axis], buf,
+                            sizeof(buf));
+        func(name, buf);
+    }
+
+    return 0;
+}
+
+static int
+bma250_ofc_save(void)
+{
+    char name[] = "bma250/ofc_x";
+    char buf[8];
+    int axis;
+    int rc;
+
+    for (axis = 0; axis < BMA250_OFC_AXES; axis++) {
+        name[sizeof(name) - 2] = 'x' + axis;
+        conf_str_from_value(CONF_INT8, &bma250_ofc_offset[axis], buf,
+                            sizeof(buf));
+        rc = conf_save_one(name, buf);
+        if (rc) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Registers the bma250 config handler so saved offsets are picked up
+ * by conf_load()
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_ofc_init(void)
+{
+    return conf_register(&bma250_ofc_conf_handler);
+}
+#endif
+
+/**
+ * Writes the stored offsets to OFC_OFFSET_X..Z in one burst, nothing is
+ * written until all three axes are known
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_ofc_restore(void)
+{
+    bma250_ofc_chip_up = 1;
+
+    if (bma250_ofc_valid != (1 << BMA250_OFC_AXES) - 1) {
+        return 0;
+    }
+
+    return bma250_writelen(BMA250_REGISTER_OFC_OFFSET_X,
+                           (uint8_t *)bma250_ofc_offset, BMA250_OFC_AXES);
+}
+
+static int
+bma250_ofc_wait(void)
+{
+    os_time_t start;
+    uint8_t ctrl;
+    int rc;
+
+    start = os_time_get();
+    do {
+        os_time_delay(1);
+
+        rc = bma250_read8(BMA250_REGISTER_OFC_CTRL,
+                          &ctrl);
+        if (rc) {
+            return rc;
+        }
+        if (ctrl & BMA250_REGISTER_OFC_CTRL_CAL_RDY) {
+            return 0;
+        }
+    } while (os_time_get() - start < BMA250_OFC_TIMEOUT);
+
+    return SYS_ETIMEOUT;
+}
+
+/**
+ * Runs the hardware fast offset compensation on all three axes. The
+ * device must be held still in a known position, e.g. flat and face up
+ * for 0g, 0g, +1g. Power mode and range are restored afterwards.
+ *
+ * @param The device object associated with this accellerometer
+ * @param The X axis target
+ * @param The Y axis target
+ * @param The Z axis target
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+bma250_calibrate(struct bma250 *lsm, enum bma250_ofc_target x,
+                 enum bma250_ofc_target y, enum bma250_ofc_target z)
+{
+    int8_t offset[BMA250_OFC_AXES];
+    uint8_t setting;
+    int axis;
+    int rc;
+    int rc2;
+
+    /* Fast compensation only runs in normal mode and +/-2g */
+    rc = bma250_set_pmu_mode(lsm, BMA250_PMU_MODE_NORMAL, 0);
+    if (rc != 0) {
+        goto err;
+    }
+
+    rc = bma250_write8(BMA250_REGISTER_PMU_RANGE,
+                       BMA250_ACCEL_RANGE_2);
+    if (rc != 0) {
+        goto restore;
+    }
+
+    /* Start from zero so the old offsets do not bias the average */
+    rc = bma250_write8(BMA250_REGISTER_OFC_CTRL,
+                       BMA250_REGISTER_OFC_CTRL_OFFSET_RESET);
+    if (rc != 0) {
+        goto restore;
+    }
+
+    setting = (x << BMA250_REGISTER_OFC_SETTING_TARGET_X_SHIFT) |
+              (y << BMA250_REGISTER_OFC_SETTING_TARGET_Y_SHIFT) |
+              (z << BMA250_REGISTER_OFC_SETTING_TARGET_Z_SHIFT);
+    rc = bma250_write8(BMA250_REGISTER_OFC_SETTING,
+                       setting);
+    if (rc != 0) {
+        goto restore;
+    }
+
+    /* One axis at a time, cal_trigger 1..3 selects x..z */
+    for (axis = 0; axis < BMA250_OFC_AXES; axis++) {
+        rc = bma250_write8(BMA250_REGISTER_OFC_CTRL,
+                           (axis + 1) <<
+                           BMA250_REGISTER_OFC_CTRL_CAL_TRIGGER_SHIFT);
+        if (rc != 0) {
+            goto restore;
+        }
+
+        rc = bma250_ofc_wait();
+        if (rc != 0) {
+            goto restore;
+        }
+    }
+
+    rc = bma250_readlen(BMA250_REGISTER_OFC_OFFSET_X,
+                        (uint8_t *)offset, sizeof(offset));
+    if (rc != 0) {
+        goto restore;
+    }
+
+    memcpy(bma250_ofc_offset, offset, sizeof(offset));
+    bma250_ofc_valid = (1 << BMA250_OFC_AXES) - 1;
+
+restore:
+    /* The chip was left with reset offsets, put the last good ones back */
+    if (rc != 0) {
+        bma250_ofc_restore();
+    }
+
+    rc2 = bma250_write8(BMA250_REGISTER_PMU_RANGE, lsm->cfg.accel_range);
+    if (rc == 0) {
+        rc = rc2;
+    }
+
+    rc2 = bma250_set_pmu_mode(lsm, lsm->cfg.pmu_mode, lsm->cfg.sleep_dur);
+    if (rc == 0) {
+        rc = rc2;
+    }
+
+    if (rc != 0) {
+        goto err;
+    }
+
+#if MYNEWT_VAL(BMA250_OFC_CONF)
+    rc = bma250_ofc_save();
+    if (rc != 0) {
+        goto err;
+    }
+#endif
+
+    return 0;
+err:
+    return rc;
+}
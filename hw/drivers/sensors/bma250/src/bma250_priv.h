@@ -20,6 +20,8 @@
 #ifndef __BMA250_PRIV_H__
 #define __BMA250_PRIV_H__
 
+#include "regmap/regmap.h"
+
 #define BMA250_ADDR_ACCEL                     (0x18) /* 0011000 */
 
 #ifdef __cplusplus
@@ -93,10 +95,113 @@ enum bma250_registers {                         /* TYPE */
     BMA250_REGISTER_FIFO_DATA           = 0x3F  /* r  */
 };
 
+/* Last register the cache covers */
+#define BMA250_REGMAP_MAX                           BMA250_REGISTER_FIFO_DATA
+
+#define BMA250_REGISTER_PMU_RANGE_RANGE             (0x0F)
+#define BMA250_REGISTER_PMU_BW_BW                   (0x1F)
+
+#define BMA250_REGISTER_PMU_LPW_SUSPEND             (1 << 7)
+#define BMA250_REGISTER_PMU_LPW_LOWPOWER_EN         (1 << 6)
+#define BMA250_REGISTER_PMU_LPW_DEEP_SUSPEND        (1 << 5)
+#define BMA250_REGISTER_PMU_LPW_SLEEP_DUR           (0x1E)
+
+/* Time from leaving suspend or low power until registers accept writes
+ * back to back and the data registers update again */
+#define BMA250_PMU_WAKEUP_US                        (1800)
+
+#define BMA250_REGISTER_OFC_CTRL_OFFSET_RESET       (1 << 7)
+#define BMA250_REGISTER_OFC_CTRL_CAL_TRIGGER_SHIFT  (5)
+#define BMA250_REGISTER_OFC_CTRL_CAL_RDY            (1 << 4)
+
+#define BMA250_REGISTER_OFC_SETTING_TARGET_X_SHIFT  (1)
+#define BMA250_REGISTER_OFC_SETTING_TARGET_Y_SHIFT  (3)
+#define BMA250_REGISTER_OFC_SETTING_TARGET_Z_SHIFT  (5)
+
+#define BMA250_REGISTER_FIFO_STATUS_OVERRUN         (1 << 7)
+#define BMA250_REGISTER_FIFO_STATUS_FRAMES          (0x7F)
+
+#define BMA250_REGISTER_INT_STATUS_0_FLAT           (1 << 7)
+#define BMA250_REGISTER_INT_STATUS_0_ORIENT         (1 << 6)
+#define BMA250_REGISTER_INT_STATUS_0_S_TAP          (1 << 5)
+#define BMA250_REGISTER_INT_STATUS_0_D_TAP          (1 << 4)
+#define BMA250_REGISTER_INT_STATUS_0_SLO_NO_MOT     (1 << 3)
+#define BMA250_REGISTER_INT_STATUS_0_SLOPE          (1 << 2)
+
+#define BMA250_REGISTER_INT_STATUS_1_DATA           (1 << 7)
+#define BMA250_REGISTER_INT_STATUS_1_FWM            (1 << 6)
+#define BMA250_REGISTER_INT_STATUS_1_FFULL          (1 << 5)
+
+#define BMA250_REGISTER_INT_STATUS_3_FLAT           (1 << 7)
+#define BMA250_REGISTER_INT_STATUS_3_FACE_DOWN      (1 << 6)
+#define BMA250_REGISTER_INT_STATUS_3_ORIENT         (0x30)
+#define BMA250_REGISTER_INT_STATUS_3_ORIENT_SHIFT   (4)
+
+#define BMA250_REGISTER_INT_EN_0_FLAT               (1 << 7)
+#define BMA250_REGISTER_INT_EN_0_ORIENT             (1 << 6)
+#define BMA250_REGISTER_INT_EN_0_S_TAP              (1 << 5)
+#define BMA250_REGISTER_INT_EN_0_D_TAP              (1 << 4)
+#define BMA250_REGISTER_INT_EN_0_SLOPE_XYZ          (0x07)
+
+#define BMA250_REGISTER_INT_EN_1_FWM                (1 << 6)
+#define BMA250_REGISTER_INT_EN_1_FFULL              (1 << 5)
+#define BMA250_REGISTER_INT_EN_1_DATA               (1 << 4)
+
+#define BMA250_REGISTER_INT_EN_2_SLO_NO_MOT_SEL     (1 << 3)
+#define BMA250_REGISTER_INT_EN_2_SLO_NO_MOT_XYZ     (0x07)
+
+/* INT_MAP_0 routes to INT1, INT_MAP_2 uses the same layout for INT2 */
+#define BMA250_REGISTER_INT_MAP_0_FLAT              (1 << 7)
+#define BMA250_REGISTER_INT_MAP_0_ORIENT            (1 << 6)
+#define BMA250_REGISTER_INT_MAP_0_S_TAP             (1 << 5)
+#define BMA250_REGISTER_INT_MAP_0_D_TAP             (1 << 4)
+#define BMA250_REGISTER_INT_MAP_0_SLO_NO_MOT        (1 << 3)
+#define BMA250_REGISTER_INT_MAP_0_SLOPE             (1 << 2)
+
+#define BMA250_REGISTER_INT_MAP_1_INT2_DATA         (1 << 7)
+#define BMA250_REGISTER_INT_MAP_1_INT2_FWM          (1 << 6)
+#define BMA250_REGISTER_INT_MAP_1_INT2_FFULL        (1 << 5)
+#define BMA250_REGISTER_INT_MAP_1_INT1_FFULL        (1 << 2)
+#define BMA250_REGISTER_INT_MAP_1_INT1_FWM          (1 << 1)
+#define BMA250_REGISTER_INT_MAP_1_INT1_DATA         (1 << 0)
+
+#define BMA250_REGISTER_INT_OUT_CTRL_INT2_OD        (1 << 3)
+#define BMA250_REGISTER_INT_OUT_CTRL_INT2_LVL       (1 << 2)
+#define BMA250_REGISTER_INT_OUT_CTRL_INT1_OD        (1 << 1)
+#define BMA250_REGISTER_INT_OUT_CTRL_INT1_LVL       (1 << 0)
+
+#define BMA250_REGISTER_INT_RST_LATCH_RESET_INT     (1 << 7)
+#define BMA250_REGISTER_INT_RST_LATCH_LATCHED       (0x07)
+
+#define BMA250_REGISTER_INT_5_SLO_NO_MOT_DUR_SHIFT  (2)
+#define BMA250_REGISTER_INT_5_SLOPE_DUR             (0x03)
+#define BMA250_REGISTER_INT_8_TAP_DUR               (0x07)
+#define BMA250_REGISTER_INT_9_TAP_TH                (0x1F)
+#define BMA250_REGISTER_INT_C_FLAT_THETA            (0x3F)
+
+#define BMA250_REGISTER_FIFO_CONFIG_0_WATER_MARK    (0x3F)
+
+/* Bits 7:6 take enum bma250_fifo_mode, data select 0 stores XYZ frames */
+#define BMA250_REGISTER_FIFO_CONFIG_1_XYZ           (0x00)
+
+/* One XYZ frame, 10-bit left-aligned little endian values */
+#define BMA250_FIFO_FRAME_LEN                       (6)
+
+int bma250_write8(uint8_t reg, uint8_t value);
+int bma250_read8(uint8_t reg, uint8_t *value);
+int bma250_read48(uint8_t reg, uint8_t *buffer);
+int bma250_writelen(uint8_t reg, const uint8_t *buffer, uint8_t len);
+int bma250_readlen(uint8_t reg, uint8_t *buffer, uint16_t len);
+int bma250_set8(uint8_t reg, uint8_t value);
+int bma250_clear8(uint8_t reg, uint8_t value);
+int bma250_seq_apply(const struct regmap_seq *seq, int count);
 
-int bma250_write8(uint8_t addr, uint8_t reg, uint32_t value);
-int bma250_read8(uint8_t addr, uint8_t reg, uint8_t *value);
-int bma250_read48(uint8_t addr, uint8_t reg, uint8_t *buffer);
+struct os_eventq *bma250_evq_get(void);
+int bma250_fifo_configure(struct bma250_cfg *cfg);
+void bma250_fifo_drain(uint8_t status);
+int bma250_int_configure(struct bma250 *lsm);
+int bma250_ofc_init(void);
+int bma250_ofc_restore(void);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,8 @@
 #include "os/os.h"
 #include "os/os_dev.h"
 #include "sensor/sensor.h"
+#include "gpio_ring/gpio_ring.h"
+#include "accel_fixed/accel_fixed.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -80,6 +82,69 @@ struct lis2dh_click_event {
     enum lis2dh_click_dir direction;
 };
 
+/* Governor profiles, in increasing rate and power */
+enum lis2dh_gov_profile {
+    LIS2DH_GOV_LOW                  = 0x00, /* 10hz low power */
+    LIS2DH_GOV_MID                  = 0x01, /* 50hz normal */
+    LIS2DH_GOV_HIGH                 = 0x02, /* 400hz high resolution */
+};
+
+/* A consumer's minimum profile, see lis2dh_gov_request() */
+struct lis2dh_gov_req {
+    enum lis2dh_gov_profile min;
+    SLIST_ENTRY(lis2dh_gov_req) next;
+};
+
+/* Interrupt generator, 1 drives INT1 and 2 drives INT2 */
+enum lis2dh_int_gen {
+    LIS2DH_INT_GEN_OFF              = 0x00,
+    LIS2DH_INT_GEN_1                = 0x01,
+    LIS2DH_INT_GEN_2                = 0x02,
+};
+
+/* Axis pointing up, away from gravity */
+enum lis2dh_orient {
+    LIS2DH_ORIENT_UNKNOWN           = 0x00,
+    LIS2DH_ORIENT_X_UP              = 0x01,
+    LIS2DH_ORIENT_X_DOWN            = 0x02,
+    LIS2DH_ORIENT_Y_UP              = 0x03,
+    LIS2DH_ORIENT_Y_DOWN            = 0x04,
+    LIS2DH_ORIENT_Z_UP              = 0x05,
+    LIS2DH_ORIENT_Z_DOWN            = 0x06,
+};
+
+struct lis2dh_orient_event {
+    enum lis2dh_orient orient;
+    uint32_t ts;                        /* os_cputime of the INT edge */
+};
+
+struct lis2dh_ff_event {
+    uint8_t falling;                    /* 1 at the start, 0 at the end */
+    uint32_t ts;                        /* os_cputime of the INT edge */
+};
+
+struct lis2dh_act_event {
+    uint8_t sleeping;                   /* dropped to low-power 10Hz */
+    uint32_t ts;                        /* os_cputime of the INT2 edge */
+};
+
+/* Samples held by the hardware FIFO */
+#define LIS2DH_FIFO_DEPTH 32
+
+struct lis2dh_fifo_sample {
+    uint32_t ts;                        /* os_cputime */
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+struct lis2dh_fifo_batch {
+    uint8_t count;
+    uint8_t overrun;                    /* older samples were overwritten */
+    uint8_t trigger;                    /* first sample after the trigger */
+    struct lis2dh_fifo_sample samples[LIS2DH_FIFO_DEPTH];
+};
+
 #if MYNEWT_VAL(LIS2DH_CLI)
 int
 lis2dh_shell_init(void);
@@ -89,6 +154,8 @@ struct lis2dh_cfg {
     enum lis2dh_accel_pwr_mode accel_mode;
     enum lis2dh_accel_range accel_range;
     enum lis2dh_accel_rate accel_rate;
+    //push data ready samples as SENSOR_TYPE_ACCEL_FIXED instead of floats
+    uint8_t fixed_output;
     enum lis2dh_click_mode click_mode;
     enum lis2dh_click_dir click_direction;
     //single
@@ -98,6 +165,34 @@ struct lis2dh_cfg {
     uint8_t click_time_window;
     uint8_t click_time_latency;
     os_event_fn *click_cb;
+    //fifo, 0 leaves the fifo in bypass mode, max 31
+    uint8_t fifo_watermark;
+    //trigger mode, 0 keeps stream mode, else freeze the fifo around the
+    //first INT1 high event above this threshold on any axis
+    uint8_t fifo_trigger_threshold;
+    uint8_t fifo_trigger_duration;
+    os_event_fn *fifo_cb;
+    //sleep-to-wake, 0 disables, max 127, the int2 level is the state so
+    //it needs click and the int2 generator off
+    uint8_t act_threshold;
+    uint8_t act_duration;
+    os_event_fn *act_cb;
+    //orientation, gen 1 needs the fifo trigger off, gen 2 needs act off
+    enum lis2dh_int_gen orient_gen;
+    uint8_t orient_4d;
+    uint8_t orient_threshold;
+    uint8_t orient_duration;
+    os_event_fn *orient_cb;
+    //free fall, on the generator orientation does not use
+    enum lis2dh_int_gen ff_gen;
+    uint8_t ff_threshold;
+    uint8_t ff_duration;
+    os_event_fn *ff_cb;
+    //read every sample on data ready and hand it to the sensor listeners,
+    //needs the fifo off
+    uint8_t drdy;
+    //let the governor pick accel_rate and accel_mode from signal energy
+    uint8_t governor;
 };
 
 struct lis2dh {
@@ -105,6 +200,10 @@ struct lis2dh {
     struct sensor sensor;
     struct lis2dh_cfg cfg;
     os_time_t last_read_time;
+    /* os_cputime of the data ready edge of the last sample in drdy mode */
+    uint32_t last_sample_time;
+    /* The next read is for that edge and carries its stamp */
+    uint8_t sample_time_pending;
 };
 
 int
@@ -119,6 +218,41 @@ lis2dh_default_cfg(struct lis2dh_cfg *cfg);
 int
 lis2dh_get_vector_data(void *datastruct, struct lis2dh *lis);
 
+int
+lis2dh_get_fixed_data(struct accel_fixed_data *afd, struct lis2dh *lis);
+
+/**
+ * Set the edge coalescing of an INT pin, kept across reconfiguration
+ *
+ * @param The INT pin, 1 or 2
+ * @param The coalescing, all zero passes every edge
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int
+lis2dh_int_coalesce(uint8_t pin, const struct gpio_ring_coalesce *co);
+
+/**
+ * Ask the governor for at least a profile
+ *
+ * @param The request, must stay valid until released
+ * @param The lowest profile the consumer can live with
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int
+lis2dh_gov_request(struct lis2dh_gov_req *req, enum lis2dh_gov_profile min);
+
+/**
+ * Drop a request made with lis2dh_gov_request()
+ *
+ * @param The request
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int
+lis2dh_gov_release(struct lis2dh_gov_req *req);
+
 /**
  * Get temperature from bno055 sensor
  *
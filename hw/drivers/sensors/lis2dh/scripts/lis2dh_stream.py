@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Decode the output of `lis2dh stream <rate> <count>`.
+
+Each frame is A5 5A, a 16 bit sequence number and the raw left-aligned
+X, Y and Z words, all little endian, followed by a CRC16-CCITT (initial
+value 0) over the sequence and sample bytes. The text summary the command
+prints at the end is passed through to stderr.
+
+Reads a capture file, or a serial port when pyserial is installed:
+
+    lis2dh_stream.py capture.bin > samples.csv
+    lis2dh_stream.py --port /dev/ttyUSB0 --baud 115200 > samples.csv
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = b'\xa5\x5a'
+FRAME_LEN = 12
+
+
+def crc16_ccitt(data, crc=0):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xffff
+            else:
+                crc = (crc << 1) & 0xffff
+    return crc
+
+
+def decode(buf, out, err):
+    """Decode frames from buf, returns (frames, bad crc, lost, leftover)."""
+    frames = bad = lost = 0
+    last_seq = None
+    pos = 0
+    while True:
+        start = buf.find(SYNC, pos)
+        if start < 0 or len(buf) - start < FRAME_LEN:
+            # Keep a possible partial frame for the next chunk
+            keep = start if start >= 0 else max(len(buf) - 1, pos)
+            text = buf[pos:keep]
+            if text.strip():
+                err.write(text.decode('ascii', 'replace'))
+            return frames, bad, lost, buf[keep:]
+
+        text = buf[pos:start]
+        if text.strip():
+            err.write(text.decode('ascii', 'replace'))
+
+        frame = buf[start:start + FRAME_LEN]
+        seq, x, y, z, crc = struct.unpack('<HhhhH', frame[2:])
+        if crc16_ccitt(frame[2:10]) != crc:
+            bad += 1
+            pos = start + 1
+            continue
+
+        if last_seq is not None:
+            lost += (seq - last_seq - 1) & 0xffff
+        last_seq = seq
+        frames += 1
+        out.write('%u,%d,%d,%d\n' % (seq, x, y, z))
+        pos = start + FRAME_LEN
+
+
+def chunks(args):
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=args.timeout) as ser:
+            while True:
+                data = ser.read(4096)
+                if not data:
+                    return
+                yield data
+    else:
+        with open(args.file, 'rb') if args.file != '-' else \
+                sys.stdin.buffer as f:
+            while True:
+                data = f.read(4096)
+                if not data:
+                    return
+                yield data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('file', nargs='?', default='-',
+                        help='capture file, - for stdin')
+    parser.add_argument('--port', help='serial port to read from')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--timeout', type=float, default=2.0,
+                        help='seconds of silence that end a serial capture')
+    parser.add_argument('--crlf', action='store_true',
+                        help='undo a console that expands \\n to \\r\\n')
+    args = parser.parse_args()
+
+    sys.stdout.write('seq,x,y,z\n')
+    total = bad = lost = 0
+    buf = b''
+    for data in chunks(args):
+        buf += data
+        if args.crlf:
+            # Hold back a trailing \r that may pair with the next chunk
+            tail = b'\r' if buf.endswith(b'\r') else b''
+            buf = buf[:len(buf) - len(tail)].replace(b'\r\n', b'\n') + tail
+        n, b, l, buf = decode(buf, sys.stdout, sys.stderr)
+        total += n
+        bad += b
+        lost += l
+
+    sys.stderr.write('\n%d frames, %d bad crc, %d lost\n' % (total, bad, lost))
+    return 0 if bad == 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
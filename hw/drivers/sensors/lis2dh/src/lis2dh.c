@@ -29,6 +29,7 @@
 #include "hal/hal_spi.h"
 #include "sensor/sensor.h"
 #include "sensor/accel.h"
+#include "accel_fixed/accel_fixed.h"
 #include "lis2dh/lis2dh.h"
 #include "lis2dh_priv.h"
 
@@ -86,18 +87,136 @@ static const struct sensor_driver g_lis2dh_sensor_driver = {
     lis2dh_sensor_get_config
 };
 
+/* Device in data ready mode */
+static struct lis2dh *g_lis2dh_drdy;
+
+/**
+ * @return The event queue driver events run on, the one INT pins drain on
+ */
+struct os_eventq *
+lis2dh_evq_get(void)
+{
+    return gpio_ring_evq_get();
+}
+
+static void
+lis2dh_drdy_src(struct lis2dh_int_src *src)
+{
+    struct lis2dh *lis;
+
+    lis = g_lis2dh_drdy;
+    if (lis == NULL) {
+        return;
+    }
+
+    lis->last_sample_time = src->ts;
+    lis->sample_time_pending = 1;
+    lis->last_read_time = os_time_get();
+
+    /* Reading the sample clears data ready, listeners get it from the
+     * sensor framework */
+    sensor_read(&lis->sensor, lis->cfg.fixed_output ?
+                SENSOR_TYPE_ACCEL_FIXED : SENSOR_TYPE_ACCELEROMETER,
+                NULL, NULL, OS_TIMEOUT_NEVER);
+    lis->sample_time_pending = 0;
+}
+
+/**
+ * Routes data ready to INT1 and reads every sample as it arrives, or
+ * stops doing so when cfg.drdy is 0
+ *
+ * @param The device to configure
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+static int
+lis2dh_drdy_configure(struct lis2dh *lis)
+{
+    struct lis2dh_cfg *cfg;
+    int16_t discard[3];
+    int rc;
+
+    cfg = &lis->cfg;
+    g_lis2dh_drdy = NULL;
+    lis2dh_demux_clear(LIS2DH_SRC_DRDY);
+
+    if (!cfg->drdy) {
+        rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG3,
+                           LIS2DH_REGISTER_CTRL_REG3_I1_DRDY);
+        if (rc != 0) {
+            goto error;
+        }
+        goto done;
+    }
+
+    /* Samples come out of the FIFO when it is on */
+    if (cfg->fifo_watermark || cfg->fifo_trigger_threshold) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    g_lis2dh_drdy = lis;
+
+    rc = lis2dh_demux_set(LIS2DH_SRC_DRDY, 1, lis2dh_drdy_src, 0);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG3,
+                     LIS2DH_REGISTER_CTRL_REG3_I1_DRDY); //data ready on int1
+    if (rc != 0) {
+        goto error;
+    }
+
+    /* A sample already waiting holds INT1 high without an edge */
+    rc = lis2dh_readlen(LIS2DH_REGISTER_OUT_X_L, (uint8_t *)discard,
+                        sizeof(discard));
+    if (rc != 0) {
+        goto error;
+    }
+
+done:
+    return 0;
+error:
+    g_lis2dh_drdy = NULL;
+    lis2dh_demux_clear(LIS2DH_SRC_DRDY);
+    return rc;
+}
+
 int
 lis2dh_default_cfg(struct lis2dh_cfg *cfg)
 {
+    memset(cfg, 0, sizeof(*cfg));
+
     cfg->accel_mode = LIS2DH_PWR_MODE_SUSPEND;
     cfg->accel_range = LIS2DH_ACCEL_RANGE_2;
     cfg->accel_rate = LIS2DH_ACCEL_RATE_OFF;
+    cfg->fixed_output = 0;
     cfg->click_mode = LIS2DH_CLICK_OFF;
     cfg->click_direction = LIS2DH_CLICK_ALL;
     cfg->click_threshold = 127; //if getting single clicks randomly, move up?, max 127
     cfg->click_time_limit = 127; //max 127
     cfg->click_time_window = 0x7f;
     cfg->click_time_latency = 128; //if getting double clicks randomly, move up?
+    cfg->click_cb = NULL;
+    cfg->fifo_watermark = 0;
+    cfg->fifo_trigger_threshold = 0;
+    cfg->fifo_trigger_duration = 0;
+    cfg->act_threshold = 0;
+    cfg->act_duration = 0;
+    cfg->act_cb = NULL;
+    cfg->orient_gen = LIS2DH_INT_GEN_OFF;
+    cfg->orient_4d = 0;
+    cfg->orient_threshold = 0x21; //~0.5g at 2g, about 30 degrees of tilt
+    cfg->orient_duration = 0;
+    cfg->orient_cb = NULL;
+    cfg->ff_gen = LIS2DH_INT_GEN_OFF;
+    cfg->ff_threshold = 0x16; //~350mg at 2g
+    cfg->ff_duration = 0x03; //30ms at 100hz
+    cfg->ff_cb = NULL;
+    cfg->drdy = 0;
+    cfg->governor = 0;
+    cfg->fifo_cb = NULL;
 
     return 0;
 }
@@ -140,10 +259,22 @@ lis2dh_init(struct os_dev *dev, void *arg)
     hal_spi_set_txrx_cb(MYNEWT_VAL(LIS2DH_SPIBUS), NULL, NULL);
     hal_spi_enable(MYNEWT_VAL(LIS2DH_SPIBUS));
 
+    rc = lis2dh_regmap_init();
+    if (rc) {
+        goto error;
+    }
+
 #if MYNEWT_VAL(LIS2DH_LOG)
     log_register("lis2dh", &_log, &log_console_handler, NULL, LOG_SYSLEVEL);
 #endif
 
+#if MYNEWT_VAL(LIS2DH_CLI)
+    rc = lis2dh_shell_init();
+    if (rc) {
+        goto error;
+    }
+#endif
+
     sensor = &lis->sensor;
 
 #if MYNEWT_VAL(LIS2DH_STATS)
@@ -164,7 +295,8 @@ lis2dh_init(struct os_dev *dev, void *arg)
     }
 
     /* Add the accelerometer driver */
-    rc = sensor_set_driver(sensor, SENSOR_TYPE_ACCELEROMETER,
+    rc = sensor_set_driver(sensor,
+                           SENSOR_TYPE_ACCELEROMETER | SENSOR_TYPE_ACCEL_FIXED,
                            (struct sensor_driver *) &g_lis2dh_sensor_driver);
     if (rc != 0) {
         goto error;
@@ -228,116 +360,170 @@ lis2dh_config(struct lis2dh *lis, struct lis2dh_cfg *cfg)
         goto error;
     }
 
+    rc = lis2dh_gov_configure(&lis->cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    /* The FIFO trigger, orientation and free fall share the generators,
+     * release them all before any is armed again */
+    rc = lis2dh_int_gen_teardown();
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_fifo_configure(&lis->cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_drdy_configure(lis);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_act_configure(&lis->cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_orient_configure(&lis->cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_ff_configure(&lis->cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
     return 0;
 error:
     return (rc);
 }
 
 /**
- * Get vector data from sensor
+ * Get an integer sample from sensor
  *
  * @param pointer to the structure to be filled up
- * @param Type of sensor
+ * @param The device
  * @return 0 on success, non-zero on error
  */
 int
-lis2dh_get_vector_data(void *datastruct, struct lis2dh *lis)
+lis2dh_get_fixed_data(struct accel_fixed_data *afd, struct lis2dh *lis)
 {
-    uint8_t payload[6];
     int16_t x, y, z;
-    struct sensor_accel_data *sad;
-    float mg_lsb;
+    uint32_t mg_lsb;
     int rc;
 
-    memset (payload, 0, 6);
-
-    x = y = z = 0;
+    /* Output words are little endian, like the host, so each axis is
+     * read straight into its variable */
+    struct regmap_iov iov[3] = {
+        { (uint8_t *)&x, 2 },
+        { (uint8_t *)&y, 2 },
+        { (uint8_t *)&z, 2 },
+    };
 
-    rc = lis2dh_readlen(LIS2DH_REGISTER_OUT_X_L,
-                       payload, 6);
+    rc = lis2dh_readv(LIS2DH_REGISTER_OUT_X_L, iov, 3);
     if (rc) {
         goto error;
     }
 
     uint8_t resolution_shift;
 
-    switch(lis->cfg.accel_mode) {
-        case LIS2DH_PWR_MODE_HIGHRESOLUTION:
-            // 12-bit
-            resolution_shift = 4;
-            break;
-        case LIS2DH_PWR_MODE_NORMAL:
-            // 10-bit
-            resolution_shift = 6;
-            break;
-        case LIS2DH_PWR_MODE_LOWPOWER:
-            //8-bit
-            resolution_shift = 8;
-            break;
-        default:
-            rc = SYS_EINVAL;
-            goto error;
+    rc = lis2dh_get_resolution_shift(&lis->cfg, &resolution_shift);
+    if (rc) {
+        goto error;
     }
 
+    lis2dh_gov_feed(x >> 4, y >> 4, z >> 4);
+
     /* Shift n-bit left-aligned accel values into 16-bit int */
-    x = ((int16_t)(payload[0] | (payload[1] << 8))) >> resolution_shift;
-    y = ((int16_t)(payload[2] | (payload[3] << 8))) >> resolution_shift;
-    z = ((int16_t)(payload[4] | (payload[5] << 8))) >> resolution_shift;
+    afd->afd_raw_x = x >> resolution_shift;
+    afd->afd_raw_y = y >> resolution_shift;
+    afd->afd_raw_z = z >> resolution_shift;
 
     // LIS2DH_INFO("x:%u\ty:%u\tz:%u\n",
     //             x, y, z);
 
-    sad = datastruct;
-
+    /* mg per lsb at 12 bits, each bit less doubles it */
     switch(lis->cfg.accel_range) {
         case LIS2DH_ACCEL_RANGE_2:
 #if MYNEWT_VAL(LIS2DH_STATS)
             STATS_INC(g_lis2dhstats, samples_acc_2g);
 #endif
-            mg_lsb = 0.005F;
+            mg_lsb = 1;
             break;
         case LIS2DH_ACCEL_RANGE_4:
 #if MYNEWT_VAL(LIS2DH_STATS)
             STATS_INC(g_lis2dhstats, samples_acc_4g);
 #endif
-            mg_lsb = 0.008F;
+            mg_lsb = 2;
             break;
         case LIS2DH_ACCEL_RANGE_8:
 #if MYNEWT_VAL(LIS2DH_STATS)
             STATS_INC(g_lis2dhstats, samples_acc_8g);
 #endif
-            mg_lsb = 0.016F;
+            mg_lsb = 4;
             break;
         case LIS2DH_ACCEL_RANGE_16:
 #if MYNEWT_VAL(LIS2DH_STATS)
             STATS_INC(g_lis2dhstats, samples_acc_16g);
 #endif
-            mg_lsb = 0.048F;
+            mg_lsb = 12;
             break;
         default:
             LIS2DH_ERR("Unknown accel range: 0x%02X. Assuming +/-2G.\n",
                 lis->cfg.accel_range);
-            mg_lsb = 0.005F;
+            mg_lsb = 1;
             break;
     }
 
+    afd->afd_scale = mg_lsb << (resolution_shift - 4 + ACCEL_FIXED_SCALE_SHIFT);
+    afd->afd_x = accel_fixed_mg(afd->afd_raw_x, afd->afd_scale);
+    afd->afd_y = accel_fixed_mg(afd->afd_raw_y, afd->afd_scale);
+    afd->afd_z = accel_fixed_mg(afd->afd_raw_z, afd->afd_scale);
+
+    /* The next sample may come at another rate and resolution */
+    rc = lis2dh_gov_update();
+    if (rc) {
+        goto error;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+/**
+ * Get vector data from sensor
+ *
+ * @param pointer to the struct sensor_accel_data to be filled up
+ * @param The device
+ * @return 0 on success, non-zero on error
+ */
+int
+lis2dh_get_vector_data(void *datastruct, struct lis2dh *lis)
+{
+    struct accel_fixed_data afd;
+    struct sensor_accel_data *sad;
+    int rc;
+
+    rc = lis2dh_get_fixed_data(&afd, lis);
+    if (rc) {
+        return rc;
+    }
+
     /* Convert from mg to Earth gravity in m/s^2 */
-    sad->sad_x = (float)x * mg_lsb * 9.80665F;
-    sad->sad_y = (float)y * mg_lsb * 9.80665F;
-    sad->sad_z = (float)z * mg_lsb * 9.80665F;
+    sad = datastruct;
+    accel_fixed_to_float(&afd, sad);
 
     // char tmpstr[13];
     // LIS2DH_INFO("x: %s", sensor_ftostr(sad->sad_x, tmpstr, 13));
     // LIS2DH_INFO("y: %s", sensor_ftostr(sad->sad_y, tmpstr, 13));
     // LIS2DH_INFO("z: %s", sensor_ftostr(sad->sad_z, tmpstr, 13));
 
-    sad->sad_x_is_valid = 1;
-    sad->sad_y_is_valid = 1;
-    sad->sad_z_is_valid = 1;
-
     return 0;
-error:
-    return rc;
 }
 
 /**
@@ -351,17 +537,23 @@ int
 lis2dh_get_temp(int8_t *temp)
 {
     int rc;
-    uint8_t rx[2];
+    uint8_t low;
+    int8_t high;
 
     /* Both OUT_TEMP_H and OUT_TEMP_L registers must be read. */
-    rc = lis2dh_readlen(LIS2DH_REGISTER_OUT_TEMP_L, rx, 2);
+    struct regmap_iov iov[2] = {
+        { &low, 1 },
+        { (uint8_t *)&high, 1 },
+    };
+
+    rc = lis2dh_readv(LIS2DH_REGISTER_OUT_TEMP_L, iov, 2);
     if (rc) {
         goto error;
     }
 
     /* Temperature data is stored inside OUT_TEMP_H as 2’s complement data in 8 bit format left
     justified. */
-    *temp = (int8_t)rx[1] + 25; //todo, not actually calibrated
+    *temp = high + 25; //todo, not actually calibrated
 
     return 0;
 error:
@@ -372,36 +564,45 @@ int
 lis2dh_sensor_read(struct sensor *sensor, sensor_type_t type,
                    sensor_data_func_t data_func, void *data_arg, uint32_t timeout)
 {
-    void *databuf;
+    struct sensor_accel_data sad;
+    struct accel_fixed_data afd;
     struct lis2dh *lis;
+    void *data;
     int rc;
-        
-    lis = (struct lis2dh *) SENSOR_GET_DEVICE(sensor);
 
-    /* Since this is the biggest struct, malloc space for it */
-    databuf = malloc(sizeof(struct sensor_accel_data));
-    assert(databuf != NULL);
+    lis = (struct lis2dh *) SENSOR_GET_DEVICE(sensor);
 
     if (type == SENSOR_TYPE_ACCELEROMETER) {
         /* Get vector data accel values */
-        rc = lis2dh_get_vector_data(databuf, lis);
+        rc = lis2dh_get_vector_data(&sad, lis);
         if (rc) {
             goto err;
         }
+        data = &sad;
+    } else if (type == SENSOR_TYPE_ACCEL_FIXED) {
+        rc = lis2dh_get_fixed_data(&afd, lis);
+        if (rc) {
+            goto err;
+        }
+        data = &afd;
     } else{
         rc = SYS_EINVAL;
         goto err;
     }
 
+    /* A data ready sample is stamped with its edge rather than with the
+     * time the framework got around to reading it */
+    if (lis->sample_time_pending) {
+        lis->sample_time_pending = 0;
+        sensor->s_sts.st_cputime = lis->last_sample_time;
+    }
+
     /* Call data function */
-    rc = data_func(sensor, data_arg, databuf);
+    rc = data_func(sensor, data_arg, data);
     if (rc) {
         goto err;
     }
 
-    /* Free the data buffer */
-    free(databuf);
-
     return 0;
 err:
     return rc;
@@ -419,13 +620,15 @@ lis2dh_sensor_get_config(struct sensor *sensor, sensor_type_t type,
 {
     int rc;
 
-    if ((type != SENSOR_TYPE_ACCELEROMETER)) {
+    if (type == SENSOR_TYPE_ACCELEROMETER) {
+        cfg->sc_valtype = SENSOR_VALUE_TYPE_FLOAT_TRIPLET;
+    } else if (type == SENSOR_TYPE_ACCEL_FIXED) {
+        cfg->sc_valtype = SENSOR_VALUE_TYPE_INT32_TRIPLET;
+    } else {
         rc = SYS_EINVAL;
         goto error;
     }
 
-    cfg->sc_valtype = SENSOR_VALUE_TYPE_FLOAT_TRIPLET;
-
     return 0;
 error:
     return rc;
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bsp/bsp.h"
+#include "hal/hal_gpio.h"
+#include "lis2dh/lis2dh.h"
+#include "lis2dh_priv.h"
+
+/*
+ * Sleep-to-wake: once the acceleration stays below Act_THS for Act_DUR
+ * the chip drops to 10Hz low-power on its own, and goes back to the
+ * programmed ODR and mode as soon as it is exceeded again. P2_ACT mirrors
+ * the state on INT2, high while asleep, so both edges are watched and the
+ * pin level tells which way it went.
+ */
+
+static struct lis2dh_act_event act_event;
+static struct os_event act_ev = {
+    .ev_arg = &act_event,
+};
+
+static void
+lis2dh_act_src(struct lis2dh_int_src *src)
+{
+    if (src->pin_level == act_event.sleeping) {
+        return;
+    }
+
+    act_event.sleeping = src->pin_level;
+    act_event.ts = src->ts;
+
+    if (act_ev.ev_cb) {
+        os_eventq_put(lis2dh_evq_get(), &act_ev);
+    }
+}
+
+/**
+ * Configures the activity/inactivity engine on INT2, or turns it off when
+ * cfg->act_threshold is 0
+ *
+ * @param The configuration to apply
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_act_configure(struct lis2dh_cfg *cfg)
+{
+    int rc;
+
+    if (cfg->act_threshold == 0) {
+        rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG6,
+                           LIS2DH_REGISTER_CTRL_REG6_P2_ACT);
+        if (rc != 0) {
+            goto error;
+        }
+
+        rc = lis2dh_write8(LIS2DH_REGISTER_Act_THS, 0);
+        if (rc != 0) {
+            goto error;
+        }
+
+        lis2dh_demux_clear(LIS2DH_SRC_ACT);
+        goto done;
+    }
+
+    /* The level on INT2 would be meaningless with click pulses on it */
+    if (cfg->click_mode != LIS2DH_CLICK_OFF) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    /* LSB is the full scale / 128, 16mg at 2g */
+    rc = lis2dh_write8(LIS2DH_REGISTER_Act_THS, cfg->act_threshold & 0x7F);
+    if (rc != 0) {
+        goto error;
+    }
+
+    /* LSB is 8 / ODR */
+    rc = lis2dh_write8(LIS2DH_REGISTER_Act_DUR, cfg->act_duration);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG6,
+                     LIS2DH_REGISTER_CTRL_REG6_P2_ACT); //activity on int2
+    if (rc != 0) {
+        goto error;
+    }
+
+    act_event.sleeping = 0;
+    act_ev.ev_cb = cfg->act_cb;
+
+    rc = lis2dh_demux_set(LIS2DH_SRC_ACT, 2, lis2dh_act_src, 1);
+    if (rc != 0) {
+        goto error;
+    }
+
+done:
+    return 0;
+error:
+    return rc;
+}
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bsp/bsp.h"
+#include "hal/hal_gpio.h"
+#include "gpio_ring/gpio_ring.h"
+#include "lis2dh/lis2dh.h"
+#include "lis2dh_priv.h"
+
+/*
+ * Interrupt demultiplexer. Each INT pin feeds its edges through the GPIO
+ * ring, which keeps the level and time of every edge. Each edge snapshots
+ * the status registers of the sources routed to that pin and passes the
+ * snapshot to each of them. Reading INT1_SOURCE, INT2_SOURCE or CLICK_SRC
+ * clears its latched event, so a register is only read on the edges of
+ * the pin its sources are routed to, and an edge on the other pin never
+ * consumes it. Sources that only need the pin level or data ready read
+ * nothing.
+ */
+
+struct lis2dh_demux_handler {
+    lis2dh_src_fn fn;
+    uint8_t pin;                        /* 1 or 2, 0 when unused */
+    uint8_t both_edges;
+};
+
+static struct lis2dh_demux_handler lis2dh_demux_handlers[LIS2DH_SRC_MAX];
+static struct gpio_ring_pin lis2dh_demux_pins[2];
+
+/* Status registers in the snapshot */
+#define LIS2DH_DEMUX_FIFO_SRC   (1 << 0)
+#define LIS2DH_DEMUX_INT1_SRC   (1 << 1)
+#define LIS2DH_DEMUX_INT2_SRC   (1 << 2)
+#define LIS2DH_DEMUX_CLICK_SRC  (1 << 3)
+
+/* Status registers each source reads, the FIFO trigger is generator 1 */
+static const uint8_t lis2dh_demux_status[LIS2DH_SRC_MAX] = {
+    [LIS2DH_SRC_FIFO]   = LIS2DH_DEMUX_FIFO_SRC | LIS2DH_DEMUX_INT1_SRC,
+    [LIS2DH_SRC_GEN1]   = LIS2DH_DEMUX_INT1_SRC,
+    [LIS2DH_SRC_GEN2]   = LIS2DH_DEMUX_INT2_SRC,
+    [LIS2DH_SRC_CLICK]  = LIS2DH_DEMUX_CLICK_SRC,
+};
+
+static int
+lis2dh_demux_gpio(uint8_t pin)
+{
+    return (pin == 1) ? LIS2DH_INT_1 : LIS2DH_INT_2;
+}
+
+static void
+lis2dh_demux_edge(struct gpio_ring_pin *gp, int level, uint32_t ts)
+{
+    struct lis2dh_int_src src;
+    uint8_t pin;
+    uint8_t status;
+    uint8_t both_edges;
+    int i;
+    int rc;
+
+    pin = (gp == &lis2dh_demux_pins[0]) ? 1 : 2;
+
+    memset(&src, 0, sizeof(src));
+    src.ts = ts;
+    src.pin_level = !!level;
+
+    status = 0;
+    both_edges = 0;
+    for (i = 0; i < LIS2DH_SRC_MAX; i++) {
+        if (lis2dh_demux_handlers[i].pin != pin) {
+            continue;
+        }
+        status |= lis2dh_demux_status[i];
+        if (lis2dh_demux_handlers[i].both_edges) {
+            both_edges = 1;
+        }
+    }
+
+    rc = 0;
+    if (status & LIS2DH_DEMUX_FIFO_SRC) {
+        rc = lis2dh_read8(LIS2DH_REGISTER_FIFO_SRC_REG, &src.fifo_src);
+    }
+    if (!rc && (status & LIS2DH_DEMUX_INT1_SRC)) {
+        rc = lis2dh_read8(LIS2DH_REGISTER_INT1_SOURCE, &src.int1_src);
+    }
+    if (!rc && (status & LIS2DH_DEMUX_INT2_SRC)) {
+        rc = lis2dh_read8(LIS2DH_REGISTER_INT2_SOURCE, &src.int2_src);
+    }
+    if (!rc && (status & LIS2DH_DEMUX_CLICK_SRC)) {
+        rc = lis2dh_read8(LIS2DH_REGISTER_CLICK_SRC, &src.click_src);
+    }
+    if (rc) {
+        return;
+    }
+
+    for (i = 0; i < LIS2DH_SRC_MAX; i++) {
+        if (lis2dh_demux_handlers[i].pin == pin) {
+            lis2dh_demux_handlers[i].fn(&src);
+        }
+    }
+
+    /* A source that asserted while the others were handled keeps the
+     * shared line high without a new rising edge. On a pin that takes
+     * both edges the level is the state and staying high is expected. */
+    if (!both_edges && hal_gpio_read(gp->pin)) {
+        gpio_ring_inject(gp);
+    }
+}
+
+/*
+ * Sets up the GPIO interrupt of a pin for the sources now routed to it.
+ */
+static int
+lis2dh_demux_pin_update(uint8_t pin)
+{
+    struct gpio_ring_pin *gp;
+    hal_gpio_irq_trig_t trig;
+    uint8_t used;
+    int rc;
+    int i;
+
+    gp = &lis2dh_demux_pins[pin - 1];
+
+    used = 0;
+    trig = HAL_GPIO_TRIG_RISING;
+    for (i = 0; i < LIS2DH_SRC_MAX; i++) {
+        if (lis2dh_demux_handlers[i].pin == pin) {
+            used = 1;
+            if (lis2dh_demux_handlers[i].both_edges) {
+                trig = HAL_GPIO_TRIG_BOTH;
+            }
+        }
+    }
+
+    gpio_ring_pin_release(gp);
+    if (!used) {
+        return 0;
+    }
+
+    rc = gpio_ring_pin_init(gp, lis2dh_demux_gpio(pin), trig,
+                            HAL_GPIO_PULL_NONE, lis2dh_demux_edge, NULL);
+    if (rc) {
+        return rc;
+    }
+
+    /* A level already high would never give an edge */
+    if (hal_gpio_read(lis2dh_demux_gpio(pin))) {
+        gpio_ring_inject(gp);
+    }
+
+    return 0;
+}
+
+/**
+ * Routes an interrupt source to a handler
+ *
+ * @param The source
+ * @param The INT pin the chip signals it on, 1 or 2
+ * @param The handler, called with the status snapshot of every edge
+ * @param Non-zero when the handler needs falling edges as well
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_demux_set(enum lis2dh_src src, uint8_t pin, lis2dh_src_fn fn,
+                 uint8_t both_edges)
+{
+    uint8_t old_pin;
+    int rc;
+
+    if (src >= LIS2DH_SRC_MAX || (pin != 1 && pin != 2) || fn == NULL) {
+        return SYS_EINVAL;
+    }
+
+    old_pin = lis2dh_demux_handlers[src].pin;
+    lis2dh_demux_handlers[src].fn = fn;
+    lis2dh_demux_handlers[src].pin = pin;
+    lis2dh_demux_handlers[src].both_edges = both_edges;
+
+    if (old_pin && old_pin != pin) {
+        rc = lis2dh_demux_pin_update(old_pin);
+        if (rc) {
+            goto error;
+        }
+    }
+
+    rc = lis2dh_demux_pin_update(pin);
+    if (rc) {
+        goto error;
+    }
+
+    return 0;
+error:
+    /* Nothing is delivered for a source whose pin could not be armed */
+    lis2dh_demux_clear(src);
+    return rc;
+}
+
+/**
+ * Stops delivering an interrupt source
+ *
+ * @param The source
+ */
+void
+lis2dh_demux_clear(enum lis2dh_src src)
+{
+    uint8_t pin;
+
+    if (src >= LIS2DH_SRC_MAX) {
+        return;
+    }
+
+    pin = lis2dh_demux_handlers[src].pin;
+    lis2dh_demux_handlers[src].pin = 0;
+    lis2dh_demux_handlers[src].fn = NULL;
+
+    if (pin) {
+        lis2dh_demux_pin_update(pin);
+    }
+}
+
+int
+lis2dh_int_coalesce(uint8_t pin, const struct gpio_ring_coalesce *co)
+{
+    if (pin != 1 && pin != 2) {
+        return SYS_EINVAL;
+    }
+
+    gpio_ring_pin_coalesce(&lis2dh_demux_pins[pin - 1], co);
+
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bsp/bsp.h"
+#include "hal/hal_gpio.h"
+#include "lis2dh/lis2dh.h"
+#include "lis2dh_priv.h"
+
+/*
+ * Stream mode keeps the newest LIS2DH_FIFO_DEPTH samples in the chip and
+ * raises INT1 once more than fifo_watermark are queued. Each watermark
+ * drains the whole FIFO in one burst; with the FIFO enabled the output
+ * registers wrap from OUT_Z_H back to OUT_X_L, so one auto-incrementing
+ * read returns consecutive samples.
+ *
+ * Trigger mode streams into the FIFO until the INT1 generator fires, then
+ * keeps filling in FIFO mode until full. The latched INT1 event tells the
+ * host how much history came before the trigger, the overrun that follows
+ * tells it the post-trigger window is complete, and the FIFO is read out
+ * and re-armed.
+ */
+
+enum lis2dh_fifo_state {
+    LIS2DH_FIFO_STATE_OFF,
+    LIS2DH_FIFO_STATE_STREAM,
+    LIS2DH_FIFO_STATE_ARMED,
+    LIS2DH_FIFO_STATE_TRIGGERED
+};
+
+static struct lis2dh_cfg *lis2dh_fifo_cfg;
+static uint8_t lis2dh_fifo_state;
+static uint8_t lis2dh_fifo_pre;
+static uint32_t lis2dh_fifo_period;
+
+static uint8_t lis2dh_fifo_raw[LIS2DH_FIFO_DEPTH * 6];
+
+static struct lis2dh_fifo_batch fifo_batch;
+static struct os_event fifo_batch_ev = {
+    .ev_arg = &fifo_batch,
+};
+
+static int
+lis2dh_fifo_set_period(struct lis2dh_cfg *cfg)
+{
+    uint32_t hz;
+    int rc;
+
+    rc = lis2dh_get_rate_hz(cfg, &hz);
+    if (rc != 0) {
+        return rc;
+    }
+    lis2dh_fifo_period = os_cputime_usecs_to_ticks(1000000 / hz);
+
+    return 0;
+}
+
+static int
+lis2dh_fifo_arm(void)
+{
+    int rc;
+
+    /* Going through bypass empties the FIFO */
+    rc = lis2dh_write8(LIS2DH_REGISTER_FIFO_CTRL_REG,
+                       LIS2DH_REGISTER_FIFO_CTRL_REG_FM_BYPASS);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* TR cleared, trigger on the INT1 generator */
+    rc = lis2dh_write8(LIS2DH_REGISTER_FIFO_CTRL_REG,
+                       LIS2DH_REGISTER_FIFO_CTRL_REG_FM_TRIGGER);
+    if (rc != 0) {
+        return rc;
+    }
+
+    //trigger and full fifo on int1
+    return lis2dh_set8(LIS2DH_REGISTER_CTRL_REG3,
+                       LIS2DH_REGISTER_CTRL_REG3_I1_AOI1 |
+                       LIS2DH_REGISTER_CTRL_REG3_I1_OVERRUN);
+}
+
+/*
+ * Reads how many samples sat in the FIFO when the trigger fired: the
+ * current level minus the samples that arrived since the INT1 edge.
+ */
+static void
+lis2dh_fifo_triggered(uint8_t source, uint32_t irq_time)
+{
+    uint32_t elapsed;
+    uint8_t level;
+
+    elapsed = (os_cputime_get32() - irq_time) / lis2dh_fifo_period;
+    if (source & LIS2DH_REGISTER_FIFO_SRC_REG_OVRN) {
+        level = LIS2DH_FIFO_DEPTH;
+    } else {
+        level = source & LIS2DH_REGISTER_FIFO_SRC_REG_FSS;
+    }
+
+    lis2dh_fifo_pre = (elapsed < level) ? level - elapsed : 0;
+    lis2dh_fifo_state = LIS2DH_FIFO_STATE_TRIGGERED;
+}
+
+static void
+lis2dh_fifo_src(struct lis2dh_int_src *src)
+{
+    struct lis2dh_cfg *cfg;
+    struct lis2dh_fifo_sample *sample;
+    uint32_t irq_time;
+    int32_t newest;
+    uint8_t *raw;
+    uint8_t source;
+    uint8_t shift;
+    uint8_t count;
+    int i;
+    int rc;
+
+    cfg = lis2dh_fifo_cfg;
+    if (cfg == NULL) {
+        return;
+    }
+
+    irq_time = src->ts;
+    newest = -1;
+    source = src->fifo_src;
+
+    if (lis2dh_fifo_state == LIS2DH_FIFO_STATE_ARMED) {
+        /* The snapshot read cleared the INT1 latch */
+        if (src->int1_src & LIS2DH_REGISTER_INT_SRC_IA) {
+            lis2dh_fifo_triggered(source, irq_time);
+            /* The edge stamped the trigger sample */
+            newest = lis2dh_fifo_pre;
+
+            /* Leave INT1 to the overrun so it gets an edge of its own,
+             * then catch an overrun that rose before the pin dropped */
+            rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG3,
+                               LIS2DH_REGISTER_CTRL_REG3_I1_AOI1);
+            if (rc) {
+                return;
+            }
+            rc = lis2dh_read8(LIS2DH_REGISTER_FIFO_SRC_REG, &source);
+            if (rc) {
+                return;
+            }
+        }
+    }
+
+    if (lis2dh_fifo_state == LIS2DH_FIFO_STATE_TRIGGERED) {
+        /* Wait for the post-trigger window to fill the FIFO */
+        if (!(source & LIS2DH_REGISTER_FIFO_SRC_REG_OVRN)) {
+            return;
+        }
+        count = LIS2DH_FIFO_DEPTH;
+        /* Otherwise the edge was the overrun, on the newest sample */
+        if (newest < 0) {
+            newest = LIS2DH_FIFO_DEPTH - 1;
+        }
+    } else if (lis2dh_fifo_state == LIS2DH_FIFO_STATE_STREAM) {
+        if (source & LIS2DH_REGISTER_FIFO_SRC_REG_OVRN) {
+            count = LIS2DH_FIFO_DEPTH;
+        } else {
+            count = source & LIS2DH_REGISTER_FIFO_SRC_REG_FSS;
+        }
+        /* The sample at index fifo_watermark is the one that raised INT1 */
+        newest = cfg->fifo_watermark;
+    } else {
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    rc = lis2dh_readlen(LIS2DH_REGISTER_OUT_X_L, lis2dh_fifo_raw, count * 6);
+    if (rc) {
+        return;
+    }
+
+    rc = lis2dh_get_resolution_shift(cfg, &shift);
+    if (rc) {
+        return;
+    }
+
+    fifo_batch.count = count;
+    if (lis2dh_fifo_state == LIS2DH_FIFO_STATE_TRIGGERED) {
+        fifo_batch.overrun = 0;
+        fifo_batch.trigger = lis2dh_fifo_pre;
+
+        rc = lis2dh_fifo_arm();
+        if (rc) {
+            return;
+        }
+        lis2dh_fifo_state = LIS2DH_FIFO_STATE_ARMED;
+    } else {
+        fifo_batch.overrun = !!(source & LIS2DH_REGISTER_FIFO_SRC_REG_OVRN);
+        fifo_batch.trigger = 0;
+    }
+
+    /* Samples are one output period apart from the one that raised INT1 */
+    raw = lis2dh_fifo_raw;
+    for (i = 0; i < count; i++) {
+        sample = &fifo_batch.samples[i];
+        sample->ts = irq_time +
+                     (int32_t)(i - newest) * (int32_t)lis2dh_fifo_period;
+        sample->x = ((int16_t)(raw[0] | (raw[1] << 8))) >> 4;
+        sample->y = ((int16_t)(raw[2] | (raw[3] << 8))) >> 4;
+        sample->z = ((int16_t)(raw[4] | (raw[5] << 8))) >> 4;
+        lis2dh_gov_feed(sample->x, sample->y, sample->z);
+        sample->x >>= shift - 4;
+        sample->y >>= shift - 4;
+        sample->z >>= shift - 4;
+        raw += 6;
+    }
+
+    if (fifo_batch_ev.ev_cb) {
+        os_eventq_put(lis2dh_evq_get(), &fifo_batch_ev);
+    }
+
+    /* A new rate applies from the next batch on */
+    if (lis2dh_gov_update() == 0) {
+        lis2dh_fifo_set_period(cfg);
+    }
+}
+
+static int
+lis2dh_fifo_trigger_configure(struct lis2dh_cfg *cfg)
+{
+    int rc;
+
+    /* High-pass the INT1 generator so the threshold ignores gravity */
+    rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG2,
+                     LIS2DH_REGISTER_CTRL_REG2_HPIS);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = lis2dh_write8(LIS2DH_REGISTER_INT1_THS,
+                       cfg->fifo_trigger_threshold & 0x7F);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = lis2dh_write8(LIS2DH_REGISTER_INT1_DURATION,
+                       cfg->fifo_trigger_duration & 0x7F);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = lis2dh_write8(LIS2DH_REGISTER_INT1_CFG,
+                       LIS2DH_REGISTER_INT_CFG_OR |
+                       LIS2DH_REGISTER_INT_CFG_XHIE |
+                       LIS2DH_REGISTER_INT_CFG_YHIE |
+                       LIS2DH_REGISTER_INT_CFG_ZHIE);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* Latch the event so the edge is not lost while the overrun is low */
+    rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG5,
+                     LIS2DH_REGISTER_CTRL_REG5_LIR_INT1);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return lis2dh_fifo_arm();
+}
+
+/**
+ * Configures the FIFO from cfg: trigger mode when fifo_trigger_threshold
+ * is set, stream mode with a watermark interrupt on INT1 when
+ * fifo_watermark is set, bypass mode otherwise
+ *
+ * @param The configuration, must stay valid while the FIFO runs
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_fifo_configure(struct lis2dh_cfg *cfg)
+{
+    int rc;
+
+    lis2dh_demux_clear(LIS2DH_SRC_FIFO);
+    lis2dh_fifo_cfg = NULL;
+    lis2dh_fifo_state = LIS2DH_FIFO_STATE_OFF;
+
+    /* Going through bypass empties the FIFO */
+    rc = lis2dh_write8(LIS2DH_REGISTER_FIFO_CTRL_REG,
+                       LIS2DH_REGISTER_FIFO_CTRL_REG_FM_BYPASS);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG3,
+                       LIS2DH_REGISTER_CTRL_REG3_I1_WTM |
+                       LIS2DH_REGISTER_CTRL_REG3_I1_AOI1 |
+                       LIS2DH_REGISTER_CTRL_REG3_I1_OVERRUN);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (cfg->fifo_watermark == 0 && cfg->fifo_trigger_threshold == 0) {
+        rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG5,
+                           LIS2DH_REGISTER_CTRL_REG5_LIR_FIFO_EN);
+        if (rc != 0) {
+            goto error;
+        }
+        goto done;
+    }
+
+    if (cfg->fifo_watermark > LIS2DH_REGISTER_FIFO_CTRL_REG_FTH) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    rc = lis2dh_fifo_set_period(cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG5,
+                     LIS2DH_REGISTER_CTRL_REG5_LIR_FIFO_EN);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (cfg->fifo_trigger_threshold) {
+        rc = lis2dh_fifo_trigger_configure(cfg);
+        if (rc != 0) {
+            goto error;
+        }
+        lis2dh_fifo_state = LIS2DH_FIFO_STATE_ARMED;
+    } else {
+        rc = lis2dh_write8(LIS2DH_REGISTER_FIFO_CTRL_REG,
+                           LIS2DH_REGISTER_FIFO_CTRL_REG_FM_STREAM |
+                           cfg->fifo_watermark);
+        if (rc != 0) {
+            goto error;
+        }
+
+        rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG3,
+                         LIS2DH_REGISTER_CTRL_REG3_I1_WTM); //watermark on int1
+        if (rc != 0) {
+            goto error;
+        }
+        lis2dh_fifo_state = LIS2DH_FIFO_STATE_STREAM;
+    }
+
+    fifo_batch_ev.ev_cb = cfg->fifo_cb;
+    lis2dh_fifo_cfg = cfg;
+
+    rc = lis2dh_demux_set(LIS2DH_SRC_FIFO, 1, lis2dh_fifo_src, 0);
+    if (rc != 0) {
+        goto error;
+    }
+
+done:
+    return 0;
+error:
+    return rc;
+}
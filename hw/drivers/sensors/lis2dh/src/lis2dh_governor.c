@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "lis2dh/lis2dh.h"
+#include "lis2dh_priv.h"
+
+/*
+ * ODR and power-mode governor. Every sample read updates a slow mean per
+ * axis and a rolling energy, the variance around that mean, in 12-bit
+ * counts squared (1mg at 2g). The profile steps up as soon as the energy
+ * crosses a threshold and steps down once it has stayed below half of it
+ * for LIS2DH_GOV_HOLD_MS, never below what a consumer asked for.
+ * CTRL_REG1 and CTRL_REG4 are only rewritten when the profile changes.
+ */
+
+/* EWMA weight of a new sample, 1 / 2^n */
+#define LIS2DH_GOV_MEAN_SHIFT   5
+#define LIS2DH_GOV_ENERGY_SHIFT 3
+
+static const struct {
+    enum lis2dh_accel_rate rate;
+    enum lis2dh_accel_pwr_mode mode;
+} lis2dh_gov_profiles[] = {
+    [LIS2DH_GOV_LOW]  = { LIS2DH_ACCEL_RATE_10,  LIS2DH_PWR_MODE_LOWPOWER },
+    [LIS2DH_GOV_MID]  = { LIS2DH_ACCEL_RATE_50,  LIS2DH_PWR_MODE_NORMAL },
+    [LIS2DH_GOV_HIGH] = { LIS2DH_ACCEL_RATE_400,
+                          LIS2DH_PWR_MODE_HIGHRESOLUTION },
+};
+
+static const int32_t lis2dh_gov_thresholds[] = {
+    [LIS2DH_GOV_MID]  = MYNEWT_VAL(LIS2DH_GOV_MID_ENERGY),
+    [LIS2DH_GOV_HIGH] = MYNEWT_VAL(LIS2DH_GOV_HIGH_ENERGY),
+};
+
+static struct lis2dh_cfg *lis2dh_gov_cfg;
+static SLIST_HEAD(, lis2dh_gov_req) lis2dh_gov_reqs =
+    SLIST_HEAD_INITIALIZER(lis2dh_gov_reqs);
+
+static enum lis2dh_gov_profile lis2dh_gov_profile;
+static uint8_t lis2dh_gov_primed;
+static int32_t lis2dh_gov_mean[3];      /* 28.4 fixed point */
+static int32_t lis2dh_gov_energy;
+static os_time_t lis2dh_gov_quiet_since;
+
+static enum lis2dh_gov_profile
+lis2dh_gov_floor(void)
+{
+    struct lis2dh_gov_req *req;
+    enum lis2dh_gov_profile floor;
+
+    floor = LIS2DH_GOV_LOW;
+    SLIST_FOREACH(req, &lis2dh_gov_reqs, next) {
+        if (req->min > floor) {
+            floor = req->min;
+        }
+    }
+
+    return floor;
+}
+
+static int
+lis2dh_gov_apply(enum lis2dh_gov_profile profile)
+{
+    struct lis2dh_cfg *cfg;
+    int rc;
+
+    cfg = lis2dh_gov_cfg;
+    if (profile == lis2dh_gov_profile &&
+        cfg->accel_rate == lis2dh_gov_profiles[profile].rate &&
+        cfg->accel_mode == lis2dh_gov_profiles[profile].mode) {
+        return 0;
+    }
+
+    cfg->accel_rate = lis2dh_gov_profiles[profile].rate;
+    cfg->accel_mode = lis2dh_gov_profiles[profile].mode;
+
+    rc = lis2dh_accel_configure(cfg);
+    if (rc) {
+        return rc;
+    }
+
+    lis2dh_gov_profile = profile;
+    lis2dh_gov_quiet_since = os_time_get();
+
+    return 0;
+}
+
+/**
+ * Adds one sample to the rolling energy
+ *
+ * @param Left-aligned output words shifted down to 12 bits
+ */
+void
+lis2dh_gov_feed(int16_t x, int16_t y, int16_t z)
+{
+    int32_t axes[3] = { x, y, z };
+    int32_t energy;
+    int32_t dev;
+    int i;
+
+    if (lis2dh_gov_cfg == NULL) {
+        return;
+    }
+
+    if (!lis2dh_gov_primed) {
+        for (i = 0; i < 3; i++) {
+            lis2dh_gov_mean[i] = axes[i] << 4;
+        }
+        lis2dh_gov_primed = 1;
+    }
+
+    energy = 0;
+    for (i = 0; i < 3; i++) {
+        dev = axes[i] - (lis2dh_gov_mean[i] >> 4);
+        lis2dh_gov_mean[i] += ((axes[i] << 4) - lis2dh_gov_mean[i]) /
+                              (1 << LIS2DH_GOV_MEAN_SHIFT);
+        energy += dev * dev;
+    }
+
+    lis2dh_gov_energy += (energy - lis2dh_gov_energy) /
+                         (1 << LIS2DH_GOV_ENERGY_SHIFT);
+}
+
+/**
+ * Moves to the profile the energy and consumers call for, to be called
+ * after a batch of samples has been fed and converted
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_gov_update(void)
+{
+    enum lis2dh_gov_profile target;
+    enum lis2dh_gov_profile floor;
+    os_time_t hold;
+    os_time_t now;
+
+    if (lis2dh_gov_cfg == NULL) {
+        return 0;
+    }
+
+    if (lis2dh_gov_energy >= lis2dh_gov_thresholds[LIS2DH_GOV_HIGH]) {
+        target = LIS2DH_GOV_HIGH;
+    } else if (lis2dh_gov_energy >= lis2dh_gov_thresholds[LIS2DH_GOV_MID]) {
+        target = LIS2DH_GOV_MID;
+    } else {
+        target = LIS2DH_GOV_LOW;
+    }
+
+    now = os_time_get();
+    if (target >= lis2dh_gov_profile) {
+        lis2dh_gov_quiet_since = now;
+    } else {
+        /* Only step down once well below the current threshold */
+        if (lis2dh_gov_energy >= lis2dh_gov_thresholds[lis2dh_gov_profile] / 2) {
+            lis2dh_gov_quiet_since = now;
+        }
+        if (os_time_ms_to_ticks(MYNEWT_VAL(LIS2DH_GOV_HOLD_MS), &hold) ||
+            OS_TIME_TICK_LT(now, lis2dh_gov_quiet_since + hold)) {
+            target = lis2dh_gov_profile;
+        } else {
+            target = lis2dh_gov_profile - 1;
+        }
+    }
+
+    floor = lis2dh_gov_floor();
+    if (target < floor) {
+        target = floor;
+    }
+
+    return lis2dh_gov_apply(target);
+}
+
+/**
+ * Registers a consumer that needs at least the given profile
+ *
+ * @param The request, must stay valid until released
+ * @param The lowest profile the consumer can live with
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_gov_request(struct lis2dh_gov_req *req, enum lis2dh_gov_profile min)
+{
+    struct lis2dh_gov_req *cur;
+
+    if (min > LIS2DH_GOV_HIGH) {
+        return SYS_EINVAL;
+    }
+
+    req->min = min;
+    SLIST_FOREACH(cur, &lis2dh_gov_reqs, next) {
+        if (cur == req) {
+            break;
+        }
+    }
+    if (cur == NULL) {
+        SLIST_INSERT_HEAD(&lis2dh_gov_reqs, req, next);
+    }
+
+    return lis2dh_gov_update();
+}
+
+/**
+ * Drops a consumer registered with lis2dh_gov_request()
+ *
+ * @param The request
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_gov_release(struct lis2dh_gov_req *req)
+{
+    struct lis2dh_gov_req *cur;
+
+    SLIST_FOREACH(cur, &lis2dh_gov_reqs, next) {
+        if (cur == req) {
+            SLIST_REMOVE(&lis2dh_gov_reqs, req, lis2dh_gov_req, next);
+            break;
+        }
+    }
+
+    /* Stepping down waits for the hold time like any other */
+    return lis2dh_gov_update();
+}
+
+/**
+ * Hands rate and power mode over to the governor when cfg->governor is
+ * set, starting from the lowest profile the consumers allow
+ *
+ * @param The configuration the governor rewrites, must stay valid
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_gov_configure(struct lis2dh_cfg *cfg)
+{
+    lis2dh_gov_cfg = NULL;
+    if (!cfg->governor) {
+        return 0;
+    }
+
+    lis2dh_gov_cfg = cfg;
+    lis2dh_gov_primed = 0;
+    lis2dh_gov_energy = 0;
+    lis2dh_gov_profile = lis2dh_gov_floor();
+
+    /* Forces the first write */
+    cfg->accel_rate = LIS2DH_ACCEL_RATE_OFF;
+
+    return lis2dh_gov_apply(lis2dh_gov_profile);
+}
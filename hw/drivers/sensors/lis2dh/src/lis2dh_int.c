@@ -0,0 +1,462 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "bsp/bsp.h"
+#include "hal/hal_gpio.h"
+#include "lis2dh/lis2dh.h"
+#include "lis2dh_priv.h"
+
+/*
+ * Features built on the two INT1/INT2 interrupt generators. Generator 1
+ * is routed to the INT1 pin and generator 2 to the INT2 pin, and their
+ * events reach the features through the demultiplexer.
+ */
+
+/* INTx_CFG, INTx_SOURCE, INTx_THS and INTx_DURATION repeat every 4 */
+#define LIS2DH_INT_GEN_REG(gen, reg) \
+    ((reg) + 4 * ((gen) - LIS2DH_INT_GEN_1))
+
+static enum lis2dh_src
+lis2dh_int_gen_src(enum lis2dh_int_gen gen)
+{
+    return (gen == LIS2DH_INT_GEN_1) ? LIS2DH_SRC_GEN1 : LIS2DH_SRC_GEN2;
+}
+
+static uint8_t
+lis2dh_int_gen_source(enum lis2dh_int_gen gen, struct lis2dh_int_src *src)
+{
+    return (gen == LIS2DH_INT_GEN_1) ? src->int1_src : src->int2_src;
+}
+
+/**
+ * Whether a generator, or the pin it drives, is taken by a feature of cfg
+ * that cannot share it
+ *
+ * @param The configuration being applied
+ * @param The generator to look at
+ *
+ * @return 1 if it is taken, 0 otherwise
+ */
+int
+lis2dh_int_gen_busy(struct lis2dh_cfg *cfg, enum lis2dh_int_gen gen)
+{
+    if (gen == LIS2DH_INT_GEN_1) {
+        /* The FIFO trigger is generator 1 */
+        return cfg->fifo_trigger_threshold != 0;
+    }
+
+    /* Activity is only told apart by the INT2 level */
+    return cfg->act_threshold != 0;
+}
+
+/**
+ * Programs an interrupt generator and routes it to its pin
+ *
+ * @param The generator to use
+ * @param INTx_CFG value, combination mode and axis events
+ * @param Threshold, LSB is the full scale / 128
+ * @param Duration, LSB is 1 / ODR
+ * @param Non-zero for 4D instead of 6D detection
+ * @param Non-zero to latch the event until INTx_SOURCE is read
+ * @param Non-zero to call the handler on falling edges as well
+ * @param The handler
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_int_gen_configure(enum lis2dh_int_gen gen, uint8_t int_cfg,
+                         uint8_t threshold, uint8_t duration, uint8_t d4d,
+                         uint8_t latch, uint8_t both_edges,
+                         lis2dh_src_fn handler)
+{
+    uint8_t source;
+    uint8_t ctrl_reg5;
+    int rc;
+
+    /* Positions and free fall are measured against gravity */
+    rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG2,
+                       (gen == LIS2DH_INT_GEN_1) ?
+                       LIS2DH_REGISTER_CTRL_REG2_HPIS :
+                       LIS2DH_REGISTER_CTRL_REG2_HPIS2);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_write8(LIS2DH_INT_GEN_REG(gen, LIS2DH_REGISTER_INT1_THS),
+                       threshold & 0x7F);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_write8(LIS2DH_INT_GEN_REG(gen, LIS2DH_REGISTER_INT1_DURATION),
+                       duration & 0x7F);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_read8(LIS2DH_REGISTER_CTRL_REG5, &ctrl_reg5);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (gen == LIS2DH_INT_GEN_1) {
+        ctrl_reg5 &= ~(LIS2DH_REGISTER_CTRL_REG5_D4D_INT1 |
+                       LIS2DH_REGISTER_CTRL_REG5_LIR_INT1);
+        if (d4d) {
+            ctrl_reg5 |= LIS2DH_REGISTER_CTRL_REG5_D4D_INT1;
+        }
+        if (latch) {
+            ctrl_reg5 |= LIS2DH_REGISTER_CTRL_REG5_LIR_INT1;
+        }
+    } else {
+        ctrl_reg5 &= ~(LIS2DH_REGISTER_CTRL_REG5_D4D_INT2 |
+                       LIS2DH_REGISTER_CTRL_REG5_LIR_INT2);
+        if (d4d) {
+            ctrl_reg5 |= LIS2DH_REGISTER_CTRL_REG5_D4D_INT2;
+        }
+        if (latch) {
+            ctrl_reg5 |= LIS2DH_REGISTER_CTRL_REG5_LIR_INT2;
+        }
+    }
+
+    rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG5, ctrl_reg5);
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_write8(LIS2DH_INT_GEN_REG(gen, LIS2DH_REGISTER_INT1_CFG),
+                       int_cfg);
+    if (rc != 0) {
+        goto error;
+    }
+
+    /* Drop a stale latched event */
+    rc = lis2dh_read8(LIS2DH_INT_GEN_REG(gen, LIS2DH_REGISTER_INT1_SOURCE),
+                      &source);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (gen == LIS2DH_INT_GEN_1) {
+        rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG3,
+                         LIS2DH_REGISTER_CTRL_REG3_I1_AOI1);
+    } else {
+        rc = lis2dh_set8(LIS2DH_REGISTER_CTRL_REG6,
+                         LIS2DH_REGISTER_CTRL_REG6_I2_INT2);
+    }
+    if (rc != 0) {
+        goto error;
+    }
+
+    rc = lis2dh_demux_set(lis2dh_int_gen_src(gen), gen, handler, both_edges);
+    if (rc != 0) {
+        goto error;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+/**
+ * Stops an interrupt generator and takes it off its pin
+ *
+ * @param The generator to stop
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_int_gen_disable(enum lis2dh_int_gen gen)
+{
+    int rc;
+
+    lis2dh_demux_clear(lis2dh_int_gen_src(gen));
+
+    rc = lis2dh_write8(LIS2DH_INT_GEN_REG(gen, LIS2DH_REGISTER_INT1_CFG), 0);
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (gen == LIS2DH_INT_GEN_1) {
+        rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG3,
+                           LIS2DH_REGISTER_CTRL_REG3_I1_AOI1);
+    } else {
+        rc = lis2dh_clear8(LIS2DH_REGISTER_CTRL_REG6,
+                           LIS2DH_REGISTER_CTRL_REG6_I2_INT2);
+    }
+    if (rc != 0) {
+        goto error;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+/*
+ * Orientation: 6D/4D position recognition, a position is reported once
+ * one axis has been beyond the threshold for the duration. 4D leaves the
+ * Z axis out.
+ */
+
+static enum lis2dh_int_gen lis2dh_orient_gen;
+
+static struct lis2dh_orient_event orient_event;
+static struct os_event orient_ev = {
+    .ev_arg = &orient_event,
+};
+
+static enum lis2dh_orient
+lis2dh_orient_decode(uint8_t source)
+{
+    if (!(source & LIS2DH_REGISTER_INT_SRC_IA)) {
+        return LIS2DH_ORIENT_UNKNOWN;
+    }
+
+    if (source & LIS2DH_REGISTER_INT_SRC_XH) {
+        return LIS2DH_ORIENT_X_UP;
+    } else if (source & LIS2DH_REGISTER_INT_SRC_XL) {
+        return LIS2DH_ORIENT_X_DOWN;
+    } else if (source & LIS2DH_REGISTER_INT_SRC_YH) {
+        return LIS2DH_ORIENT_Y_UP;
+    } else if (source & LIS2DH_REGISTER_INT_SRC_YL) {
+        return LIS2DH_ORIENT_Y_DOWN;
+    } else if (source & LIS2DH_REGISTER_INT_SRC_ZH) {
+        return LIS2DH_ORIENT_Z_UP;
+    } else if (source & LIS2DH_REGISTER_INT_SRC_ZL) {
+        return LIS2DH_ORIENT_Z_DOWN;
+    }
+
+    return LIS2DH_ORIENT_UNKNOWN;
+}
+
+static void
+lis2dh_orient_src(struct lis2dh_int_src *src)
+{
+    enum lis2dh_orient orient;
+
+    if (lis2dh_orient_gen == LIS2DH_INT_GEN_OFF) {
+        return;
+    }
+
+    orient = lis2dh_orient_decode(lis2dh_int_gen_source(lis2dh_orient_gen,
+                                                        src));
+    if (orient == LIS2DH_ORIENT_UNKNOWN || orient == orient_event.orient) {
+        return;
+    }
+
+    orient_event.orient = orient;
+    orient_event.ts = src->ts;
+
+    if (orient_ev.ev_cb) {
+        os_eventq_put(lis2dh_evq_get(), &orient_ev);
+    }
+}
+
+static int
+lis2dh_orient_stop(void)
+{
+    enum lis2dh_int_gen gen;
+
+    gen = lis2dh_orient_gen;
+    if (gen == LIS2DH_INT_GEN_OFF) {
+        return 0;
+    }
+    lis2dh_orient_gen = LIS2DH_INT_GEN_OFF;
+
+    return lis2dh_int_gen_disable(gen);
+}
+
+/**
+ * Configures 6D/4D position detection on cfg->orient_gen, or turns it off
+ *
+ * @param The configuration to apply
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_orient_configure(struct lis2dh_cfg *cfg)
+{
+    int rc;
+
+    rc = lis2dh_orient_stop();
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (cfg->orient_gen == LIS2DH_INT_GEN_OFF) {
+        goto done;
+    }
+
+    if (lis2dh_int_gen_busy(cfg, cfg->orient_gen)) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    orient_event.orient = LIS2DH_ORIENT_UNKNOWN;
+    orient_ev.ev_cb = cfg->orient_cb;
+
+    rc = lis2dh_int_gen_configure(cfg->orient_gen,
+                                  LIS2DH_REGISTER_INT_CFG_6D_POSITION |
+                                  LIS2DH_REGISTER_INT_CFG_XLIE |
+                                  LIS2DH_REGISTER_INT_CFG_XHIE |
+                                  LIS2DH_REGISTER_INT_CFG_YLIE |
+                                  LIS2DH_REGISTER_INT_CFG_YHIE |
+                                  LIS2DH_REGISTER_INT_CFG_ZLIE |
+                                  LIS2DH_REGISTER_INT_CFG_ZHIE,
+                                  cfg->orient_threshold, cfg->orient_duration,
+                                  cfg->orient_4d, 1, 0, lis2dh_orient_src);
+    if (rc != 0) {
+        goto error;
+    }
+
+    lis2dh_orient_gen = cfg->orient_gen;
+
+done:
+    return 0;
+error:
+    return rc;
+}
+
+/*
+ * Free fall: all three axes below the threshold together (AND of the low
+ * events) for the duration. The event is not latched, so the pin stays
+ * high for as long as the fall lasts and IA in INTx_SOURCE, read on each
+ * edge, tells the start from the end.
+ */
+
+static enum lis2dh_int_gen lis2dh_ff_gen;
+
+static struct lis2dh_ff_event ff_event;
+static struct os_event ff_ev = {
+    .ev_arg = &ff_event,
+};
+
+static void
+lis2dh_ff_src(struct lis2dh_int_src *src)
+{
+    uint8_t falling;
+
+    if (lis2dh_ff_gen == LIS2DH_INT_GEN_OFF) {
+        return;
+    }
+
+    falling = !!(lis2dh_int_gen_source(lis2dh_ff_gen, src) &
+                 LIS2DH_REGISTER_INT_SRC_IA);
+    if (falling == ff_event.falling) {
+        return;
+    }
+
+    ff_event.falling = falling;
+    ff_event.ts = src->ts;
+
+    if (ff_ev.ev_cb) {
+        os_eventq_put(lis2dh_evq_get(), &ff_ev);
+    }
+}
+
+static int
+lis2dh_ff_stop(void)
+{
+    enum lis2dh_int_gen gen;
+
+    gen = lis2dh_ff_gen;
+    if (gen == LIS2DH_INT_GEN_OFF) {
+        return 0;
+    }
+    lis2dh_ff_gen = LIS2DH_INT_GEN_OFF;
+
+    return lis2dh_int_gen_disable(gen);
+}
+
+/**
+ * Configures free-fall detection on cfg->ff_gen, or turns it off
+ *
+ * @param The configuration to apply
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_ff_configure(struct lis2dh_cfg *cfg)
+{
+    int rc;
+
+    rc = lis2dh_ff_stop();
+    if (rc != 0) {
+        goto error;
+    }
+
+    if (cfg->ff_gen == LIS2DH_INT_GEN_OFF) {
+        goto done;
+    }
+
+    if (cfg->ff_gen == cfg->orient_gen ||
+        lis2dh_int_gen_busy(cfg, cfg->ff_gen)) {
+        rc = SYS_EINVAL;
+        goto error;
+    }
+
+    ff_event.falling = 0;
+    ff_ev.ev_cb = cfg->ff_cb;
+
+    rc = lis2dh_int_gen_configure(cfg->ff_gen,
+                                  LIS2DH_REGISTER_INT_CFG_AND |
+                                  LIS2DH_REGISTER_INT_CFG_XLIE |
+                                  LIS2DH_REGISTER_INT_CFG_YLIE |
+                                  LIS2DH_REGISTER_INT_CFG_ZLIE,
+                                  cfg->ff_threshold, cfg->ff_duration,
+                                  0, 0, 1, lis2dh_ff_src);
+    if (rc != 0) {
+        goto error;
+    }
+
+    lis2dh_ff_gen = cfg->ff_gen;
+
+done:
+    return 0;
+error:
+    return rc;
+}
+
+/**
+ * Stops orientation and free fall on the generators they hold. Run before
+ * any feature is configured, so a generator that changes hands is not
+ * disabled after its new user armed it.
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_int_gen_teardown(void)
+{
+    int rc;
+
+    rc = lis2dh_orient_stop();
+    if (rc != 0) {
+        return rc;
+    }
+
+    return lis2dh_ff_stop();
+}
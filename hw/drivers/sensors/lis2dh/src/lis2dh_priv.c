@@ -27,6 +27,7 @@
 #include "bsp/bsp.h"
 #include "hal/hal_gpio.h"
 #include "hal/hal_spi.h"
+#include "regmap/regmap.h"
 #include "sensor/sensor.h"
 #include "sensor/accel.h"
 #include "lis2dh/lis2dh.h"
@@ -44,23 +45,23 @@ static struct os_event gpio_ev2 = {
 
 
 static void
-interrupt_ev_cb(struct os_event *ev)
+lis2dh_click_src(struct lis2dh_int_src *src)
 {
-    uint8_t rc;
     uint8_t source;
 
-    rc = lis2dh_read8(LIS2DH_REGISTER_CLICK_SRC, &source);
-    if (rc) {
+    /* Latched CLICK_SRC, cleared by the demultiplexer's read */
+    source = src->click_src;
+    if (!(source & LIS2DH_REGISTER_CLICK_SRC_IA)) {
         goto done;
     }
 
-    bool negative = source && LIS2DH_REGISTER_CLICK_SRC_Sign;
-    bool s_click = source && LIS2DH_REGISTER_CLICK_SRC_SClick;
-    bool d_click = source && LIS2DH_REGISTER_CLICK_SRC_DClick;
+    bool negative = source & LIS2DH_REGISTER_CLICK_SRC_Sign;
+    bool s_click = source & LIS2DH_REGISTER_CLICK_SRC_SClick;
+    bool d_click = source & LIS2DH_REGISTER_CLICK_SRC_DClick;
 
-    bool x = (LIS2DH_CLICK_X || LIS2DH_CLICK_ALL) && (source && LIS2DH_REGISTER_CLICK_SRC_X);
-    bool y = (LIS2DH_CLICK_Y || LIS2DH_CLICK_ALL) && (source && LIS2DH_REGISTER_CLICK_SRC_Y);
-    bool z = (LIS2DH_CLICK_Z || LIS2DH_CLICK_ALL) && (source && LIS2DH_REGISTER_CLICK_SRC_Z);
+    bool x = source & LIS2DH_REGISTER_CLICK_SRC_X;
+    bool y = source & LIS2DH_REGISTER_CLICK_SRC_Y;
+    bool z = source & LIS2DH_REGISTER_CLICK_SRC_Z;
 
     if(s_click && negative)
     {
@@ -93,55 +94,97 @@ interrupt_ev_cb(struct os_event *ev)
         click_event.direction = LIS2DH_CLICK_ALL;
     }
 
-    os_eventq_put(os_eventq_dflt_get(), &gpio_ev2);
+    if (gpio_ev2.ev_cb) {
+        os_eventq_put(lis2dh_evq_get(), &gpio_ev2);
+    }
 
     done:
     return;
 }
 
-static struct os_event gpio_ev = {
-    .ev_cb = interrupt_ev_cb,
+/* Status, output and source registers change under us, reading REFERENCE
+ * resets the high-pass filter and rewriting FIFO_CTRL_REG restarts the FIFO */
+static const uint8_t lis2dh_regmap_flags[LIS2DH_REGMAP_MAX + 1] = {
+    [LIS2DH_REGISTER_STATUS_REG_AUX]    = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_TEMP_L]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_TEMP_H]        = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_INT_COUNTER_REG]   = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_WHO_AM_I]          = REGMAP_F_RO,
+    [LIS2DH_REGISTER_REFERENCE]         = REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_STATUS_REG2]       = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_X_L]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_X_H]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_Y_L]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_Y_H]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_Z_L]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_OUT_Z_H]           = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_FIFO_CTRL_REG]     = REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_FIFO_SRC_REG]      = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_INT1_SOURCE]       = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_INT2_SOURCE]       = REGMAP_F_RO | REGMAP_F_VOLATILE,
+    [LIS2DH_REGISTER_CLICK_SRC]         = REGMAP_F_RO | REGMAP_F_VOLATILE,
 };
 
-static void
-my_gpio_irq(void *arg)
+static const struct regmap_cfg lis2dh_regmap_cfg = {
+    .bus = {
+        .type = REGMAP_BUS_SPI,
+        .num = MYNEWT_VAL(LIS2DH_SPIBUS),
+        .ss_pin = LIS2DH_SS_PIN,
+        .read_flag = LIS2DH_READ,
+        .inc_flag = LIS2DH_MULTIPLE,
+    },
+    .max_reg = LIS2DH_REGMAP_MAX,
+    .flags = lis2dh_regmap_flags,
+};
+
+static struct regmap_ent lis2dh_regmap_ents[LIS2DH_REGMAP_MAX + 1];
+static struct regmap lis2dh_regmap;
+
+/**
+ * Sets up the register cache, every register unknown until first used
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_regmap_init(void)
 {
-    os_eventq_put(os_eventq_dflt_get(), &gpio_ev);
+    return regmap_init(&lis2dh_regmap, &lis2dh_regmap_cfg,
+                       lis2dh_regmap_ents);
 }
 
 /**
- * Clears a single byte to the specified register
+ * Clears bits in a single byte of the specified register, no bus access
+ * when they are already clear
  *
  * @param The register address to write to
- * @param The value to clear
+ * @param The bits to clear
  *
  * @return 0 on success, non-zero error on failure.
  */
 int
 lis2dh_clear8(uint8_t reg, uint8_t value)
 {
-    uint8_t rc;
-    uint8_t current;
-
-    rc = lis2dh_read8(reg, &current);
-    if (rc) {
-        goto error;
-    }
-
-    current &= ~(value);
-
-    rc = lis2dh_write8(reg, current);
-    if (rc != 0) {
-        goto error;
-    }
+    return regmap_update_bits(&lis2dh_regmap, reg, value, 0);
+}
 
-    return 0;
-error:
-    return rc;
+/**
+ * Sets bits in a single byte of the specified register, no bus access
+ * when they are already set
+ *
+ * @param The register address to write to
+ * @param The bits to set
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_set8(uint8_t reg, uint8_t value)
+{
+    return regmap_update_bits(&lis2dh_regmap, reg, value, value);
 }
 
 /**
- * Writes a single byte to the specified register
+ * Writes a single byte to the specified register, skipped when the cache
+ * shows it already holds the value
  *
  * @param The register address to write to
  * @param The value to write
@@ -151,65 +194,67 @@ error:
 int
 lis2dh_write8(uint8_t reg, uint8_t value)
 {
-    int rc;
-
-    uint8_t spi_tx_buf[2];
-    spi_tx_buf[0] = reg;
-    spi_tx_buf[1] = value;
-
-    hal_gpio_write(LIS2DH_SS_PIN, 0);
-
-    /* Register write */
-    rc = hal_spi_txrx(MYNEWT_VAL(LIS2DH_SPIBUS), spi_tx_buf, NULL, 2);
-    hal_gpio_write(LIS2DH_SS_PIN, 1);
-
-    if (rc) {
-//         LIS2DH_ERR("SPI access failed spi bus %d\n", MYNEWT_VAL(LIS2DH_SPIBUS));
-// #if MYNEWT_VAL(LIS2DH_STATS)
-//         STATS_INC(g_lis2dhstats, errors);
-// #endif
-        goto error;
-    }
-
-    return 0;
-error:
-    return rc;
+    return regmap_write(&lis2dh_regmap, reg, value);
 }
 
+/**
+ * Reads a single byte, from the cache unless the register is volatile
+ *
+ * @param The register address to read from
+ * @param Pointer to where the register value should be written
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
 int
 lis2dh_read8(uint8_t reg, uint8_t *value)
 {
-    return lis2dh_readlen(reg, value, 1);
+    return regmap_read(&lis2dh_regmap, reg, value);
 }
 
+/**
+ * Applies a register table, changed registers are written in address
+ * order with consecutive ones merged into one burst
+ *
+ * @param The steps to apply
+ * @param Number of steps
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
 int
-lis2dh_readlen(uint8_t reg, uint8_t *value, uint8_t length)
+lis2dh_seq_apply(const struct regmap_seq *seq, int count)
 {
-    int rc;
-    uint8_t spi_tx_buf[1 + length];
-    uint8_t spi_rx_buf[1 + length];
-
-    spi_tx_buf[0] = reg | LIS2DH_READ | LIS2DH_MULTIPLE;
-
-    hal_gpio_write(LIS2DH_SS_PIN, 0);
-
-    /* Register write 1, read 2 */
-    rc = hal_spi_txrx(MYNEWT_VAL(LIS2DH_SPIBUS), spi_tx_buf, spi_rx_buf, 1 + length);
-    hal_gpio_write(LIS2DH_SS_PIN, 1);
-
-    if (rc) {
-//         LIS2DH_ERR("SPI access failed spi bus %d\n", MYNEWT_VAL(LIS2DH_SPIBUS));
-// #if MYNEWT_VAL(LIS2DH_STATS)
-//         STATS_INC(g_lis2dhstats, errors);
-// #endif
-        goto error;
-    }
+    return regmap_seq_apply(&lis2dh_regmap, seq, count);
+}
 
-    *value = spi_rx_buf[1];
+/**
+ * Reads consecutive registers from the chip in one transaction
+ *
+ * @param The first register address to read from
+ * @param Buffer to read into
+ * @param Number of bytes to read
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_readlen(uint8_t reg, uint8_t *value, uint8_t length)
+{
+    return regmap_readlen(&lis2dh_regmap, reg, value, length);
+}
 
-    return 0;
-error:
-    return rc;
+/**
+ * Reads consecutive registers in one transaction, scattering the bytes
+ * over the caller's buffers in order
+ *
+ * @param The first register address to read from
+ * @param The buffers to fill
+ * @param The number of buffers
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_readv(uint8_t reg, const struct regmap_iov *iov, int iovcnt)
+{
+    return regmap_readv(&lis2dh_regmap, reg, iov, iovcnt);
 }
 
 int
@@ -275,6 +320,84 @@ error:
     return rc;
 }
 
+/**
+ * Right shift that turns a left-aligned output word into a sample for the
+ * configured power mode
+ *
+ * @param The configuration to look at
+ * @param Pointer to the shift to fill in
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+lis2dh_get_resolution_shift(struct lis2dh_cfg *cfg, uint8_t *shift)
+{
+    switch(cfg->accel_mode) {
+        case LIS2DH_PWR_MODE_HIGHRESOLUTION:
+            // 12-bit
+            *shift = 4;
+            break;
+        case LIS2DH_PWR_MODE_NORMAL:
+            // 10-bit
+            *shift = 6;
+            break;
+        case LIS2DH_PWR_MODE_LOWPOWER:
+            //8-bit
+            *shift = 8;
+            break;
+        default:
+            return SYS_EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * Output data rate of the configuration in Hz
+ *
+ * @param The configuration to look at
+ * @param Pointer to the rate to fill in
+ *
+ * @return 0 on success, SYS_EINVAL when powered down
+ */
+int
+lis2dh_get_rate_hz(struct lis2dh_cfg *cfg, uint32_t *hz)
+{
+    switch(cfg->accel_rate) {
+        case LIS2DH_ACCEL_RATE_1:
+            *hz = 1;
+            break;
+        case LIS2DH_ACCEL_RATE_10:
+            *hz = 10;
+            break;
+        case LIS2DH_ACCEL_RATE_25:
+            *hz = 25;
+            break;
+        case LIS2DH_ACCEL_RATE_50:
+            *hz = 50;
+            break;
+        case LIS2DH_ACCEL_RATE_100:
+            *hz = 100;
+            break;
+        case LIS2DH_ACCEL_RATE_200:
+            *hz = 200;
+            break;
+        case LIS2DH_ACCEL_RATE_400:
+            *hz = 400;
+            break;
+        case LIS2DH_ACCEL_RATE_1620:
+            *hz = 1620;
+            break;
+        case LIS2DH_ACCEL_RATE_1344_5376:
+            *hz = (cfg->accel_mode == LIS2DH_PWR_MODE_LOWPOWER) ? 5376 : 1344;
+            break;
+        default:
+            return SYS_EINVAL;
+    }
+
+    return 0;
+}
+
 int
 lis2dh_accel_configure(struct lis2dh_cfg *cfg)
 {
@@ -311,14 +434,14 @@ lis2dh_accel_configure(struct lis2dh_cfg *cfg)
             goto error;
     }
 
-    /* Set normal mode, accel data rate and enable XYZ output */
-    rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG1, ctrl_reg1);
-    if (rc != 0) {
-        goto error;
-    }
+    const struct regmap_seq seq[] = {
+        /* Set normal mode, accel data rate and enable XYZ output */
+        { LIS2DH_REGISTER_CTRL_REG1, ctrl_reg1, 0xFF },
+        /* Set accel scale */
+        { LIS2DH_REGISTER_CTRL_REG4, ctrl_reg4, 0xFF },
+    };
 
-    /* Set accel scale */
-    rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG4, ctrl_reg4);
+    rc = lis2dh_seq_apply(seq, sizeof(seq) / sizeof(seq[0]));
     if (rc != 0) {
         goto error;
     }
@@ -337,8 +460,7 @@ lis2dh_click_configure(struct lis2dh_cfg *cfg)
     // TODO do I care if this is a second call and we already have a callback function?
 
     if (cfg->click_mode == LIS2DH_CLICK_OFF) {
-        hal_gpio_irq_release(LIS2DH_INT_2);
-        hal_gpio_irq_disable(LIS2DH_INT_2);
+        lis2dh_demux_clear(LIS2DH_SRC_CLICK);
 
         // hal_gpio_irq_release(LIS2DH_INT_1);
         // hal_gpio_irq_disable(LIS2DH_INT_1);
@@ -355,79 +477,52 @@ lis2dh_click_configure(struct lis2dh_cfg *cfg)
         goto done;
     }
 
-    rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG6,
-        LIS2DH_REGISTER_CTRL_REG6_I2_CLICK);//click on int2
-    if (rc != 0) {
-        goto error;
-    }
-
     // rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG3,
     //                    LIS2DH_REGISTER_CTRL_REG3_I1_CLICK); //click on int1
     // if (rc != 0) {
     //     goto error;
     // }
 
-    //latch until read
-    // rc = lis2dh_write8(LIS2DH_REGISTER_CTRL_REG5,
-    //                    // LIS2DH_REGISTER_CTRL_REG5_LIR_INT1
-    //                     // |
-    //                    LIS2DH_REGISTER_CTRL_REG5_LIR_INT2
-    //                   );
-    // if (rc != 0) {
-    //     goto error;
-    // }
-
     rc = lis2dh_get_click_cfg(cfg, &click_cfg);
     if (rc != 0) {
         goto error;
     }
 
-    rc = lis2dh_write8(LIS2DH_REGISTER_CLICK_CFG, click_cfg);
-    if (rc != 0) {
-        goto error;
-    }
-
-    rc = lis2dh_write8(LIS2DH_REGISTER_CLICK_THS,
-                       cfg->click_threshold);
+    const struct regmap_seq seq[] = {
+        //click on int2
+        { LIS2DH_REGISTER_CTRL_REG6, LIS2DH_REGISTER_CTRL_REG6_I2_CLICK,
+          LIS2DH_REGISTER_CTRL_REG6_I2_CLICK },
+        { LIS2DH_REGISTER_CLICK_CFG, click_cfg, 0xFF },
+        //latch until CLICK_SRC is read
+        { LIS2DH_REGISTER_CLICK_THS,
+          (cfg->click_threshold & 0x7F) | LIS2DH_REGISTER_CLICK_THS_LIR, 0xFF },
+        /*  the maximum time interval that can elapse between the start of
+            the click-detection procedure (the acceleration on the selected channel exceeds the
+            programmed threshold) and when the acceleration falls back below the threshold. */
+        { LIS2DH_REGISTER_TIME_LIMIT, cfg->click_time_limit, 0xFF },
+        /*  the time interval that starts after the first click detection where
+            the click-detection procedure is disabled, in cases where the device is configured for
+            double-click detection. */
+        { LIS2DH_REGISTER_TIME_LATENCY, cfg->click_time_latency, 0xFF },
+        /*  the maximum interval of time that can elapse after the end of the
+            latency interval in which the click-detection procedure can start, in cases where the device
+            is configured for double-click detection */
+        { LIS2DH_REGISTER_TIME_WINDOW, cfg->click_time_window, 0xFF },
+    };
+
+    /* CTRL_REG6, CLICK_CFG, then CLICK_THS..TIME_WINDOW in one burst */
+    rc = lis2dh_seq_apply(seq, sizeof(seq) / sizeof(seq[0]));
     if (rc != 0) {
         goto error;
     }
 
-    /*  the maximum time interval that can elapse between the start of
-        the click-detection procedure (the acceleration on the selected channel exceeds the
-        programmed threshold) and when the acceleration falls back below the threshold. */
-    rc = lis2dh_write8(LIS2DH_REGISTER_TIME_LIMIT,
-                       cfg->click_time_limit);
-    if (rc != 0) {
-        goto error;
-    }
-
-    /*  the time interval that starts after the first click detection where
-        the click-detection procedure is disabled, in cases where the device is configured for
-        double-click detection. */
-    rc = lis2dh_write8(LIS2DH_REGISTER_TIME_LATENCY,
-                       cfg->click_time_latency);
-    if (rc != 0) {
-        goto error;
-    }
+    gpio_ev2.ev_cb = cfg->click_cb;
 
-    /*  the maximum interval of time that can elapse after the end of the
-        latency interval in which the click-detection procedure can start, in cases where the device
-        is configured for double-click detection */
-    rc = lis2dh_write8(LIS2DH_REGISTER_TIME_WINDOW,
-                       cfg->click_time_window);
+    rc = lis2dh_demux_set(LIS2DH_SRC_CLICK, 2, lis2dh_click_src, 0);
     if (rc != 0) {
         goto error;
     }
 
-    gpio_ev2.ev_cb = cfg->click_cb;
-
-    // hal_gpio_irq_init(LIS2DH_INT_1, my_gpio_irq, NULL, HAL_GPIO_TRIG_RISING, HAL_GPIO_PULL_NONE);
-    // hal_gpio_irq_enable(LIS2DH_INT_1);
-
-    hal_gpio_irq_init(LIS2DH_INT_2, my_gpio_irq, NULL, HAL_GPIO_TRIG_RISING, HAL_GPIO_PULL_NONE);
-    hal_gpio_irq_enable(LIS2DH_INT_2);
-
 
 done:
     return 0;
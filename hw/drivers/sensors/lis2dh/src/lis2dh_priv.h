@@ -20,6 +20,8 @@
 #ifndef __LIS2DH_PRIV_H__
 #define __LIS2DH_PRIV_H__
 
+#include "hal/hal_gpio.h"
+#include "regmap/regmap.h"
 #include "lis2dh/lis2dh.h"
 
 #ifdef __cplusplus
@@ -38,6 +40,8 @@ extern "C" {
 #define LIS2DH_REGISTER_CLICK_CFG_ZD            1 << 4
 #define LIS2DH_REGISTER_CLICK_CFG_ZS            1 << 5
 
+#define LIS2DH_REGISTER_CLICK_THS_LIR           1 << 7
+
 #define LIS2DH_REGISTER_CLICK_SRC_X             1 << 0
 #define LIS2DH_REGISTER_CLICK_SRC_Y             1 << 1
 #define LIS2DH_REGISTER_CLICK_SRC_Z             1 << 2
@@ -53,6 +57,7 @@ extern "C" {
 #define LIS2DH_REGISTER_CTRL_REG1_ODR           1 << 4
 
 #define LIS2DH_REGISTER_CTRL_REG2_HPIS          1 << 0
+#define LIS2DH_REGISTER_CTRL_REG2_HPIS2         1 << 1
 #define LIS2DH_REGISTER_CTRL_REG2_HPCLICK       1 << 2
 #define LIS2DH_REGISTER_CTRL_REG2_FDS           1 << 3
 #define LIS2DH_REGISTER_CTRL_REG2_HPCF          1 << 4
@@ -60,8 +65,10 @@ extern "C" {
 
 #define LIS2DH_REGISTER_CTRL_REG3_I1_OVERRUN    1 << 1
 #define LIS2DH_REGISTER_CTRL_REG3_I1_WTM        1 << 2
-#define LIS2DH_REGISTER_CTRL_REG3_I1_DRDY       1 << 3
-#define LIS2DH_REGISTER_CTRL_REG3_I1_AOI        1 << 5
+#define LIS2DH_REGISTER_CTRL_REG3_I1_DRDY2      1 << 3
+#define LIS2DH_REGISTER_CTRL_REG3_I1_DRDY       1 << 4
+#define LIS2DH_REGISTER_CTRL_REG3_I1_AOI2       1 << 5
+#define LIS2DH_REGISTER_CTRL_REG3_I1_AOI1       1 << 6
 #define LIS2DH_REGISTER_CTRL_REG3_I1_CLICK      1 << 7
 
 #define LIS2DH_REGISTER_CTRL_REG4_SIM           1 << 0
@@ -78,6 +85,29 @@ extern "C" {
 #define LIS2DH_REGISTER_CTRL_REG5_LIR_FIFO_EN   1 << 6
 #define LIS2DH_REGISTER_CTRL_REG5_LIR_BOOT      1 << 7
 
+#define LIS2DH_REGISTER_INT_CFG_XLIE            1 << 0
+#define LIS2DH_REGISTER_INT_CFG_XHIE            1 << 1
+#define LIS2DH_REGISTER_INT_CFG_YLIE            1 << 2
+#define LIS2DH_REGISTER_INT_CFG_YHIE            1 << 3
+#define LIS2DH_REGISTER_INT_CFG_ZLIE            1 << 4
+#define LIS2DH_REGISTER_INT_CFG_ZHIE            1 << 5
+
+#define LIS2DH_REGISTER_INT_SRC_XL              1 << 0
+#define LIS2DH_REGISTER_INT_SRC_XH              1 << 1
+#define LIS2DH_REGISTER_INT_SRC_YL              1 << 2
+#define LIS2DH_REGISTER_INT_SRC_YH              1 << 3
+#define LIS2DH_REGISTER_INT_SRC_ZL              1 << 4
+#define LIS2DH_REGISTER_INT_SRC_ZH              1 << 5
+#define LIS2DH_REGISTER_INT_SRC_IA              1 << 6
+
+#define LIS2DH_REGISTER_FIFO_CTRL_REG_FTH       0x1F
+#define LIS2DH_REGISTER_FIFO_CTRL_REG_TR        1 << 5
+
+#define LIS2DH_REGISTER_FIFO_SRC_REG_FSS        0x1F
+#define LIS2DH_REGISTER_FIFO_SRC_REG_EMPTY      1 << 5
+#define LIS2DH_REGISTER_FIFO_SRC_REG_OVRN       1 << 6
+#define LIS2DH_REGISTER_FIFO_SRC_REG_WTM        1 << 7
+
 #define LIS2DH_REGISTER_CTRL_REG6_H_LACTIVE     1 << 1
 #define LIS2DH_REGISTER_CTRL_REG6_P2_ACT        1 << 3
 #define LIS2DH_REGISTER_CTRL_REG6_BOOT_I2       1 << 4
@@ -86,6 +116,29 @@ extern "C" {
 #define LIS2DH_REGISTER_CTRL_REG6_I2_CLICK      1 << 7
 
 
+/* Interrupt sources the demultiplexer delivers */
+enum lis2dh_src {
+    LIS2DH_SRC_FIFO,
+    LIS2DH_SRC_DRDY,
+    LIS2DH_SRC_GEN1,
+    LIS2DH_SRC_GEN2,
+    LIS2DH_SRC_CLICK,
+    LIS2DH_SRC_ACT,
+    LIS2DH_SRC_MAX
+};
+
+/* Status snapshot taken on an INT pin edge */
+struct lis2dh_int_src {
+    uint32_t ts;                        /* os_cputime of the edge */
+    uint8_t pin_level;
+    uint8_t fifo_src;
+    uint8_t int1_src;
+    uint8_t int2_src;
+    uint8_t click_src;
+};
+
+typedef void (*lis2dh_src_fn)(struct lis2dh_int_src *src);
+
 enum lis2dh_filter_mode {
     LIS2DH_REGISTER_CTRL_REG2_HPM_NORMAL_RESET  = (0x00 << 6),
     LIS2DH_REGISTER_CTRL_REG2_HPM_REFERENCE     = (0x01 << 6),
@@ -162,18 +215,82 @@ enum LIS2DH_registers {                         /* TYPE */
     LIS2DH_REGISTER_Act_DUR             = 0x3F, /* rw */
 };
 
+/* Last register the cache covers */
+#define LIS2DH_REGMAP_MAX                       LIS2DH_REGISTER_Act_DUR
+
+int
+lis2dh_regmap_init(void);
+
 int
 lis2dh_write8(uint8_t reg, uint8_t value);
 
 int
 lis2dh_readlen(uint8_t reg, uint8_t *value, uint8_t length);
 
+int
+lis2dh_seq_apply(const struct regmap_seq *seq, int count);
+
+int
+lis2dh_readv(uint8_t reg, const struct regmap_iov *iov, int iovcnt);
+
 int
 lis2dh_read8(uint8_t reg, uint8_t *value);
 
 int
 lis2dh_clear8(uint8_t reg, uint8_t value);
 
+int
+lis2dh_set8(uint8_t reg, uint8_t value);
+
+int
+lis2dh_get_resolution_shift(struct lis2dh_cfg *cfg, uint8_t *shift);
+
+int
+lis2dh_get_rate_hz(struct lis2dh_cfg *cfg, uint32_t *hz);
+
+int
+lis2dh_fifo_configure(struct lis2dh_cfg *cfg);
+
+int
+lis2dh_act_configure(struct lis2dh_cfg *cfg);
+
+int
+lis2dh_demux_set(enum lis2dh_src src, uint8_t pin, lis2dh_src_fn fn,
+                 uint8_t both_edges);
+
+void
+lis2dh_demux_clear(enum lis2dh_src src);
+
+int
+lis2dh_int_gen_busy(struct lis2dh_cfg *cfg, enum lis2dh_int_gen gen);
+
+int
+lis2dh_int_gen_configure(enum lis2dh_int_gen gen, uint8_t int_cfg,
+                         uint8_t threshold, uint8_t duration, uint8_t d4d,
+                         uint8_t latch, uint8_t both_edges,
+                         lis2dh_src_fn handler);
+
+int
+lis2dh_int_gen_disable(enum lis2dh_int_gen gen);
+
+int
+lis2dh_int_gen_teardown(void);
+
+int
+lis2dh_orient_configure(struct lis2dh_cfg *cfg);
+
+int
+lis2dh_ff_configure(struct lis2dh_cfg *cfg);
+
+void
+lis2dh_gov_feed(int16_t x, int16_t y, int16_t z);
+
+int
+lis2dh_gov_update(void);
+
+int
+lis2dh_gov_configure(struct lis2dh_cfg *cfg);
+
 int
 lis2dh_get_click_cfg(struct lis2dh_cfg *cfg, uint8_t *value);
 
@@ -186,6 +303,9 @@ lis2dh_click_configure(struct lis2dh_cfg *cfg);
 int
 lis2dh_verify_id();
 
+struct os_eventq *
+lis2dh_evq_get(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,11 +24,19 @@
 #include "shell/shell.h"
 #include "sensor/sensor.h"
 #include "sensor/accel.h"
+#include "accel_fixed/accel_fixed.h"
+#include "crc/crc16.h"
 #include "lis2dh/lis2dh.h"
 #include "lis2dh_priv.h"
 
 #if MYNEWT_VAL(LIS2DH_CLI)
 
+/* Binary stream frame: sync, sequence and raw left-aligned XYZ words, all
+ * little endian, then a CRC16-CCITT over everything after the sync */
+#define LIS2DH_STREAM_SYNC0     0xA5
+#define LIS2DH_STREAM_SYNC1     0x5A
+#define LIS2DH_STREAM_FRAME_LEN 12
+
 static int lis2dh_shell_cmd(int argc, char **argv);
 
 static struct shell_cmd lis2dh_shell_cmd_struct = {
@@ -66,6 +74,7 @@ lis2dh_shell_help(void)
     console_printf("%s cmd [flags...]\n", lis2dh_shell_cmd_struct.sc_cmd);
     console_printf("cmd:\n");
     console_printf("\tr\t[n_samples]\n\n");
+    console_printf("\tstream\t<rate_hz> <count>\n");
     console_printf("\tchip_id\n");
     console_printf("\tdumpreg [addr]\n");
 
@@ -94,24 +103,39 @@ lis2dh_shell_cmd_get_chip_id(int argc, char **argv)
     return 0;
 }
 
+static struct lis2dh *
+lis2dh_shell_get_dev(void)
+{
+    struct lis2dh *lis;
+
+    lis = (struct lis2dh *) os_dev_lookup(MYNEWT_VAL(LIS2DH_SHELL_DEV_NAME));
+    if (lis == NULL) {
+        console_printf("Error: no device \"%s\"\n",
+                       MYNEWT_VAL(LIS2DH_SHELL_DEV_NAME));
+    }
+
+    return lis;
+}
+
 static int
 lis2dh_shell_cmd_read(int argc, char **argv)
 {
     uint16_t samples = 1;
     long val;
     int rc;
-    void *databuf;
-    struct sensor_accel_data *sad;
+    struct sensor_accel_data sad;
+    struct accel_fixed_data afd;
     char tmpstr[13];
-    struct lis2dh lis;
+    struct lis2dh *lis;
 
     if (argc > 4) {
         return lis2dh_shell_err_too_many_args(argv[1]);
     }
 
-    /* Since this is the biggest struct, malloc space for it */
-    databuf = malloc(sizeof(struct sensor_accel_data));
-    assert(databuf != NULL);
+    lis = lis2dh_shell_get_dev();
+    if (lis == NULL) {
+        return ENODEV;
+    }
 
     /* Check if more than one sample requested */
     if (argc == 4) {
@@ -122,25 +146,163 @@ lis2dh_shell_cmd_read(int argc, char **argv)
     }
 
     while (samples--) {
-        rc = lis2dh_get_vector_data(databuf, &lis);
+        if (lis->cfg.fixed_output) {
+            rc = lis2dh_get_fixed_data(&afd, lis);
+            if (rc) {
+                console_printf("Read failed: %d\n", rc);
+                goto err;
+            }
+
+            console_printf("x:%ldmg y:%ldmg z:%ldmg\n", (long)afd.afd_x,
+                           (long)afd.afd_y, (long)afd.afd_z);
+            continue;
+        }
+
+        rc = lis2dh_get_vector_data(&sad, lis);
         if (rc) {
             console_printf("Read failed: %d\n", rc);
             goto err;
         }
-        sad = databuf;
 
-        console_printf("x:%s ", sensor_ftostr(sad->sad_x, tmpstr, 13));
-        console_printf("y:%s ", sensor_ftostr(sad->sad_y, tmpstr, 13));
-        console_printf("z:%s\n", sensor_ftostr(sad->sad_z, tmpstr, 13));
+        console_printf("x:%s ", sensor_ftostr(sad.sad_x, tmpstr, 13));
+        console_printf("y:%s ", sensor_ftostr(sad.sad_y, tmpstr, 13));
+        console_printf("z:%s\n", sensor_ftostr(sad.sad_z, tmpstr, 13));
     }
 
-    free(databuf);
-
     return 0;
 err:
     return rc;
 }
 
+/*
+ * Sleeps until a cputime deadline, through the scheduler for the bulk of
+ * the wait and spinning for the last tick.
+ */
+static void
+lis2dh_shell_wait_until(uint32_t deadline)
+{
+    int32_t left;
+    os_time_t ticks;
+
+    left = (int32_t)(deadline - os_cputime_get32());
+    if (left <= 0) {
+        return;
+    }
+
+    ticks = (os_cputime_ticks_to_usecs(left) * OS_TICKS_PER_SEC) / 1000000;
+    if (ticks > 1) {
+        os_time_delay(ticks - 1);
+    }
+
+    left = (int32_t)(deadline - os_cputime_get32());
+    if (left > 0) {
+        os_cputime_delay_ticks(left);
+    }
+}
+
+static int
+lis2dh_shell_cmd_stream(int argc, char **argv)
+{
+    uint8_t frame[LIS2DH_STREAM_FRAME_LEN];
+    struct regmap_iov iov;
+    uint32_t period;
+    uint32_t deadline;
+    uint32_t start;
+    uint32_t elapsed_us;
+    uint32_t bus_us;
+    uint32_t dropped;
+    uint32_t sent;
+    uint32_t late;
+    uint32_t t;
+    uint16_t seq;
+    uint16_t crc;
+    long rate;
+    long count;
+    int rc;
+
+    if (argc != 4) {
+        return lis2dh_shell_help();
+    }
+
+    if (sensor_shell_stol(argv[2], 1, 1000, &rate)) {
+        return lis2dh_shell_err_invalid_arg(argv[2]);
+    }
+    if (sensor_shell_stol(argv[3], 1, INT32_MAX, &count)) {
+        return lis2dh_shell_err_invalid_arg(argv[3]);
+    }
+
+    if (lis2dh_shell_get_dev() == NULL) {
+        return ENODEV;
+    }
+
+    period = os_cputime_usecs_to_ticks(1000000 / rate);
+    frame[0] = LIS2DH_STREAM_SYNC0;
+    frame[1] = LIS2DH_STREAM_SYNC1;
+    iov.buf = &frame[4];
+    iov.len = 6;
+
+    bus_us = 0;
+    dropped = 0;
+    sent = 0;
+    seq = 0;
+    rc = 0;
+
+    start = os_cputime_get32();
+    deadline = start;
+    while (sent + dropped < count) {
+        lis2dh_shell_wait_until(deadline);
+
+        /* Slots that went by while we were busy are lost, the sequence
+         * skips them so the host sees the gap */
+        late = (uint32_t)(os_cputime_get32() - deadline) / period;
+        if (late) {
+            if (late > count - sent - dropped - 1) {
+                late = count - sent - dropped - 1;
+            }
+            dropped += late;
+            seq += late;
+            deadline += late * period;
+        }
+        deadline += period;
+
+        frame[2] = seq;
+        frame[3] = seq >> 8;
+
+        t = os_cputime_get32();
+        rc = lis2dh_readv(LIS2DH_REGISTER_OUT_X_L, &iov, 1);
+        bus_us += os_cputime_ticks_to_usecs(os_cputime_get32() - t);
+        if (rc) {
+            break;
+        }
+
+        crc = crc16_ccitt(CRC16_INITIAL_CRC, &frame[2],
+                          LIS2DH_STREAM_FRAME_LEN - 4);
+        frame[10] = crc;
+        frame[11] = crc >> 8;
+
+        console_write((char *)frame, LIS2DH_STREAM_FRAME_LEN);
+        sent++;
+        seq++;
+    }
+    elapsed_us = os_cputime_ticks_to_usecs(os_cputime_get32() - start);
+
+    console_printf("\nstream: %lu sent %lu dropped in %lu ms, %lu.%02lu Hz, "
+                   "bus %lu us\n",
+                   (unsigned long)sent, (unsigned long)dropped,
+                   (unsigned long)(elapsed_us / 1000),
+                   (unsigned long)(elapsed_us ?
+                       ((uint64_t)sent * 1000000) / elapsed_us : 0),
+                   (unsigned long)(elapsed_us ?
+                       (((uint64_t)sent * 100000000) / elapsed_us) % 100 : 0),
+                   (unsigned long)bus_us);
+
+    if (rc) {
+        console_printf("Read failed: %d\n", rc);
+    }
+
+    return rc;
+}
+
 // static int
 // lis2dh_shell_cmd_pwr_mode(int argc, char **argv)
 // {
@@ -191,7 +353,8 @@ lis2dh_shell_cmd_dumpreg(int argc, char **argv)
     if (sensor_shell_stol(argv[2], 0, UINT8_MAX, &addr)) {
         return lis2dh_shell_err_invalid_arg(argv[2]);
     }
-    rc = lis2dh_read8((uint8_t)addr, &val);
+    /* From the chip, not the driver's cached copy */
+    rc = lis2dh_readlen((uint8_t)addr, &val, 1);
     if (rc) {
         goto err;
     }
@@ -230,6 +393,11 @@ lis2dh_shell_cmd(int argc, char **argv)
         return lis2dh_shell_cmd_read(argc, argv);
     }
 
+    /* Binary stream command */
+    if (argc > 1 && strcmp(argv[1], "stream") == 0) {
+        return lis2dh_shell_cmd_stream(argc, argv);
+    }
+
     /* Chip ID command */
     if (argc > 1 && strcmp(argv[1], "chip_id") == 0) {
         return lis2dh_shell_cmd_get_chip_id(argc, argv);
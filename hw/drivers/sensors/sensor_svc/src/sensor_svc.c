@@ -0,0 +1,83 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "sensor_svc/sensor_svc.h"
+
+#if MYNEWT_VAL(SENSOR_SVC_GPIO_RING)
+#include "gpio_ring/gpio_ring.h"
+#endif
+
+/*
+ * Sensor service. Interrupt handling and bus work of the sensor drivers
+ * runs on its own task and queue, above the default task, so console,
+ * shell and application events can not delay a motion or touch edge.
+ * The GPIO edge ring drains here, and the drivers run their timers and
+ * callbacks on the ring queue, so everything they do shares this task.
+ */
+
+#define SENSOR_SVC_STACK_SIZE   OS_STACK_ALIGN(MYNEWT_VAL(SENSOR_SVC_STACK_SIZE))
+
+static struct os_task sensor_svc_task;
+static os_stack_t sensor_svc_stack[SENSOR_SVC_STACK_SIZE];
+static struct os_eventq sensor_svc_evq;
+
+static void
+sensor_svc_task_handler(void *arg)
+{
+    while (1) {
+        os_eventq_run(&sensor_svc_evq);
+    }
+}
+
+/**
+ * @return The sensor service event queue.
+ */
+struct os_eventq *
+sensor_svc_evq_get(void)
+{
+    return &sensor_svc_evq;
+}
+
+/**
+ * Creates the sensor task, called through sysinit ahead of the drivers
+ */
+void
+sensor_svc_init(void)
+{
+    int rc;
+
+    os_eventq_init(&sensor_svc_evq);
+
+    rc = os_task_init(&sensor_svc_task, "sensor_svc", sensor_svc_task_handler,
+                      NULL, MYNEWT_VAL(SENSOR_SVC_TASK_PRIO), OS_WAIT_FOREVER,
+                      sensor_svc_stack, SENSOR_SVC_STACK_SIZE);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+#if MYNEWT_VAL(SENSOR_SVC_GPIO_RING)
+    rc = gpio_ring_evq_set(&sensor_svc_evq);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+}
@@ -22,19 +22,169 @@
 
 #include "os/os.h"
 #include "os/os_dev.h"
+#include "gpio_ring/gpio_ring.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+/* Completion callback for a queued transfer, rc is 0 on success */
+typedef void (*iqs263_xfer_cb)(int rc, void *arg);
+
+enum iqs263_gesture {
+    IQS263_GESTURE_TAP                  = 0x00,
+    IQS263_GESTURE_DOUBLE_TAP           = 0x01,
+    IQS263_GESTURE_LONG_PRESS           = 0x02,
+    IQS263_GESTURE_SWIPE_LEFT           = 0x03,
+    IQS263_GESTURE_SWIPE_RIGHT          = 0x04,
+    IQS263_GESTURE_FLICK_LEFT           = 0x05,
+    IQS263_GESTURE_FLICK_RIGHT          = 0x06
+};
+
+struct iqs263_gesture_event {
+    enum iqs263_gesture type;
+    uint8_t start;                      /* slider coordinate at touch down */
+    uint8_t end;                        /* last slider coordinate */
+    uint32_t duration_ms;
+};
+
+struct iqs263_gesture_cfg {
+    /* Longest touch that still counts as a tap */
+    uint16_t tap_max_ms;
+    /* Window after a tap for the second one, 0 disables double tap */
+    uint16_t double_tap_gap_ms;
+    /* Hold time reported as long press, 0 disables it */
+    uint16_t long_press_ms;
+    /* Slider travel that turns a touch into a swipe */
+    uint8_t swipe_min_dist;
+    /* Swipe speed in slider units per second reported as a flick */
+    uint16_t flick_min_speed;
+};
+
+struct iqs263_cfg {
+    /* Low-power scan interval used while idle (x 16ms), 0 disables it */
+    uint8_t lp_timer;
+    /* Time without proximity or touch before switching to low power */
+    uint32_t lp_idle_ms;
+    /* Threshold auto-tuning sample period, 0 disables the tuner */
+    uint32_t tune_period_ms;
+    /* Bounds the tuner keeps the prox threshold within, in counts */
+    uint8_t prox_thr_min;
+    uint8_t prox_thr_max;
+    /* Bounds the tuner keeps the touch thresholds within, in LTA/256 */
+    uint8_t touch_thr_min;
+    uint8_t touch_thr_max;
+    /* Software gesture recognition on slider reports */
+    struct iqs263_gesture_cfg gesture;
+    os_event_fn *gesture_cb;
+};
+
+#define IQS263_CHANNELS 4
+
+/* One raw tuning sample, channel words are little endian */
+struct iqs263_capture_frame {
+    uint32_t ts;                        /* os_cputime when requested */
+    uint16_t counts[IQS263_CHANNELS];
+    uint16_t lta[IQS263_CHANNELS];
+    uint16_t deltas[IQS263_CHANNELS];
+};
+
+struct iqs263_capture_stats {
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t elapsed_ms;
+};
+
 int iqs263_init(struct os_dev *, void *);
+int iqs263_default_cfg(struct iqs263_cfg *cfg);
+int iqs263_config(struct iqs263_cfg *cfg);
 int iqs263_event(uint8_t *value);
 int iqs263_write8(uint8_t reg, uint8_t value);
 int iqs263_read8(uint8_t reg, uint8_t *value);
 int iqs263_readlen(uint8_t reg, uint8_t *buffer, uint8_t len);
 int iqs263_writelen(uint8_t reg, uint8_t *buffer, uint8_t len);
 
+/**
+ * Queue a register read to be serviced in the next RDY window
+ *
+ * @param The register address to read from
+ * @param Buffer to read into, must stay valid until the callback runs
+ * @param Length of the buffer (MAX: 8 bytes)
+ * @param Completion callback, may be NULL
+ * @param Argument passed to the callback
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int iqs263_queue_read(uint8_t reg, uint8_t *buffer, uint8_t len,
+                      iqs263_xfer_cb cb, void *arg);
+
+/**
+ * Queue a register write to be serviced in the next RDY window. The data is
+ * copied, so the buffer may be reused as soon as this returns.
+ *
+ * @param The register address to write to
+ * @param The data buffer to write from
+ * @param Length of the buffer (MAX: 8 bytes)
+ * @param Completion callback, may be NULL
+ * @param Argument passed to the callback
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int iqs263_queue_write(uint8_t reg, uint8_t *buffer, uint8_t len,
+                       iqs263_xfer_cb cb, void *arg);
+
+/**
+ * Ask the chip to open a RDY window so queued transfers are serviced
+ * without waiting for the next touch event.
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int iqs263_request_window(void);
+
+/**
+ * Set the edge coalescing of the RDY pin, kept across windows
+ *
+ * @param The coalescing, all zero passes every edge
+ */
+void iqs263_rdy_coalesce(const struct gpio_ring_coalesce *co);
+
+/**
+ * Start sampling COUNTS, LTA and DELTAS into the capture ring
+ *
+ * @param Sample rate in Hz (MAX: OS_TICKS_PER_SEC)
+ *
+ * @return 0 on success, SYS_EALREADY while a capture is running, other
+ *         non-zero error on failure.
+ */
+int iqs263_capture_start(uint16_t rate_hz);
+int iqs263_capture_stop(void);
+
+/**
+ * Pop the oldest frame from the capture ring
+ *
+ * @param Frame to fill
+ *
+ * @return 0 on success, SYS_ENOENT if the ring is empty
+ */
+int iqs263_capture_read(struct iqs263_capture_frame *frame);
+int iqs263_capture_get_stats(struct iqs263_capture_stats *stats);
+
+/**
+ * Feed one slider report into the gesture recognizer
+ *
+ * @param Report time in os_cputime ticks, taken at the RDY edge
+ * @param Slider coordinate
+ * @param Whether any slider channel is touched
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int iqs263_gesture_feed(uint32_t now, uint8_t coord, uint8_t touching);
+
+#if MYNEWT_VAL(IQS263_CLI)
+int iqs263_shell_init(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
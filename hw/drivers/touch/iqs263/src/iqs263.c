@@ -24,8 +24,11 @@
 #include "defs/error.h"
 #include "os/os.h"
 #include "sysinit/sysinit.h"
-#include "hal/hal_i2c.h"
+#include "regmap/regmap.h"
 #include "hal/hal_gpio.h"
+#include "hal/hal_i2c.h"
+#include "os/os_cputime.h"
+#include "gpio_ring/gpio_ring.h"
 #include "iqs263/iqs263.h"
 #include "iqs263_priv.h"
 #include "bsp/bsp.h"
@@ -50,6 +53,9 @@ STATS_SECT_START(iqs263_stat_section)
     STATS_SECT_ENTRY(flickleft)
     STATS_SECT_ENTRY(flickright)
     STATS_SECT_ENTRY(irqs)
+    STATS_SECT_ENTRY(windows)
+    STATS_SECT_ENTRY(xfers)
+    STATS_SECT_ENTRY(xfer_overflows)
     STATS_SECT_ENTRY(errors)
 STATS_SECT_END
 
@@ -64,6 +70,9 @@ STATS_NAME_START(iqs263_stat_section)
     STATS_NAME(iqs263_stat_section, flickleft)
     STATS_NAME(iqs263_stat_section, flickright)
     STATS_NAME(iqs263_stat_section, irqs)
+    STATS_NAME(iqs263_stat_section, windows)
+    STATS_NAME(iqs263_stat_section, xfers)
+    STATS_NAME(iqs263_stat_section, xfer_overflows)
     STATS_NAME(iqs263_stat_section, errors)
 STATS_NAME_END(iqs263_stat_section)
 
@@ -81,22 +90,382 @@ static struct log _log;
 #define IQS263_ERR(...)
 #endif
 
+/* The chip is already waiting on us inside a RDY window, so keep this short */
+#define IQS263_WINDOW_TIMEOUT \
+    ((MYNEWT_VAL(IQS263_WINDOW_TIMEOUT_MS) * OS_TICKS_PER_SEC) / 1000 + 1)
+
+/* Transfers waiting for a RDY window, drained only from the event callback */
+static struct iqs263_xfer iqs263_xfer_queue[MYNEWT_VAL(IQS263_XFER_QUEUE_SIZE)];
+static uint8_t iqs263_xfer_head;
+static volatile uint8_t iqs263_xfer_count;
+
+static uint8_t iqs263_rdy_armed;
+
+static struct iqs263_cfg iqs263cfg;
+
+/* Low-power scan policy, switched by rewriting the low-power timer byte */
+static struct os_callout iqs263_lp_callout;
+static uint8_t iqs263_lp_active;          /* latest requested state */
+static uint8_t iqs263_lp_chip;            /* state the chip was last set to */
+static uint16_t iqs263_lp_seq;
+static uint8_t iqs263_lp_value;
+
+/* Registers are blocks of varying length at one address, accessed only in
+ * a RDY window, so the driver uses the bus layer without a cache */
+static const struct regmap_bus iqs263_bus = {
+    .type = REGMAP_BUS_I2C,
+    .num = MYNEWT_VAL(IQS263_I2CBUS),
+    .addr = IQS263_ADDR,
+};
+
+/**
+ * Ends the RDY window after a failed transfer. The transfer may have stopped
+ * before its STOP, and the chip holds the window and the bus until one is
+ * seen, so address the chip once more with an empty write.
+ */
 static void
-interrupt_ev_cb(struct os_event *ev)
+iqs263_window_end(void)
+{
+    hal_i2c_master_probe(iqs263_bus.num, iqs263_bus.addr,
+                         IQS263_WINDOW_TIMEOUT);
+}
+
+/**
+ * Writes a register block in a single I2C transaction
+ *
+ * @param The register address to write to
+ * @param The data buffer to write from
+ * @param Length of the buffer (MAX: 8 bytes)
+ * @param Timeout in OS ticks
+ * @param Whether to end with a STOP, which closes the RDY window
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+static int
+iqs263_i2c_write(uint8_t reg, uint8_t *buffer, uint8_t len, uint32_t timeout,
+                 uint8_t last_op)
+{
+    int rc;
+
+    if (len > IQS263_XFER_MAX_LEN) {
+        return SYS_EINVAL;
+    }
+
+    rc = regmap_bus_write(&iqs263_bus, reg, buffer, len, timeout, last_op);
+    if (rc) {
+        IQS263_ERR("Failed to write to 0x%02X:0x%02X\n", IQS263_ADDR, reg);
+#if MYNEWT_VAL(IQS263_STATS)
+        STATS_INC(g_iqs263stats, errors);
+#endif
+        iqs263_window_end();
+    }
+
+    return rc;
+}
+
+/**
+ * Reads a register block straight into the supplied buffer
+ *
+ * @param The register address to read from
+ * @param Buffer to read into
+ * @param Length of the buffer
+ * @param Timeout in OS ticks
+ * @param Whether to end with a STOP, which closes the RDY window
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+static int
+iqs263_i2c_read(uint8_t reg, uint8_t *buffer, uint8_t len, uint32_t timeout,
+                uint8_t last_op)
+{
+    int rc;
+
+    rc = regmap_bus_read(&iqs263_bus, reg, buffer, len, timeout, last_op);
+    if (rc) {
+        IQS263_ERR("Failed to read from 0x%02X:0x%02X\n", IQS263_ADDR, reg);
+#if MYNEWT_VAL(IQS263_STATS)
+        STATS_INC(g_iqs263stats, errors);
+#endif
+        iqs263_window_end();
+    }
+
+    return rc;
+}
+
+static void
+iqs263_lp_write_cb(int rc, void *arg)
+{
+    uintptr_t req;
+
+    /* The request carries its sequence number and the state it set */
+    req = (uintptr_t)arg;
+    if (rc == 0) {
+        iqs263_lp_chip = req & 1;
+        return;
+    }
+
+    /* Fall back to what the chip runs so the next event or timeout
+     * retries, unless a later request has taken over */
+    if ((uint16_t)(req >> 1) == iqs263_lp_seq) {
+        iqs263_lp_active = iqs263_lp_chip;
+    }
+}
+
+/**
+ * Switches between full-rate and low-power scanning with a single write of
+ * the low-power timer byte (first byte of TIMINGS_AND_TARGETS).
+ *
+ * @param 1 to enter low-power scanning, 0 to return to full rate
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+static int
+iqs263_lp_set(uint8_t enter)
+{
+    uint16_t seq;
+    int rc;
+
+    if (iqs263_lp_active == enter) {
+        return 0;
+    }
+
+    seq = iqs263_lp_seq + 1;
+    iqs263_lp_value = enter ? iqs263cfg.lp_timer : 0;
+    rc = iqs263_queue_write(IQS263_REGISTER_TIMINGS_AND_TARGETS,
+                            &iqs263_lp_value, 1, iqs263_lp_write_cb,
+                            (void *)(((uintptr_t)seq << 1) | enter));
+    if (rc) {
+        return rc;
+    }
+    iqs263_lp_seq = seq;
+    iqs263_lp_active = enter;
+
+    return 0;
+}
+
+static void
+iqs263_lp_timeout(struct os_event *ev)
+{
+    int rc;
+
+    rc = iqs263_lp_set(1);
+    if (rc == 0) {
+        /* Nothing is touching the chip, so no window would open by itself */
+        iqs263_request_window();
+    }
+}
+
+/**
+ * Feeds the chip events into the power policy: any proximity or touch
+ * activity restores full-rate scanning and restarts the idle timer.
+ *
+ * @param The events byte from SYS_FLAGS
+ */
+static void
+iqs263_lp_activity(uint8_t events)
+{
+    os_time_t ticks;
+
+    if (iqs263cfg.lp_timer == 0) {
+        return;
+    }
+
+    if (!(events & (IQS263_EVENT_PROX | IQS263_EVENT_TOUCH |
+                    IQS263_EVENT_SLIDE))) {
+        return;
+    }
+
+    iqs263_lp_set(0);
+
+    if (os_time_ms_to_ticks(iqs263cfg.lp_idle_ms, &ticks) == 0) {
+        os_callout_reset(&iqs263_lp_callout, ticks);
+    }
+}
+
+/**
+ * Reads the event state (system flags, touch bytes and coordinates) inside
+ * an open RDY window, using repeated starts between the blocks.
+ *
+ * @param Buffer of 6 bytes to read into
+ * @param Set to whether the window was left open for queued transfers, or
+ *        NULL to always close it
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+static int
+iqs263_window_read_events(uint8_t *value, uint8_t *open)
+{
+    uint8_t last_op;
+    int rc;
+
+    /* Read the system flags register to enable all events */
+    rc = iqs263_i2c_read(IQS263_REGISTER_SYS_FLAGS, &value[0], 2,
+                         IQS263_WINDOW_TIMEOUT, 0);
+    if (rc) {
+        goto error;
+    }
+
+    /* May queue a scan rate change that rides along in this window */
+    iqs263_lp_activity(value[1]);
+
+    /* Read from the touch bytes register to enable touch events */
+    rc = iqs263_i2c_read(IQS263_REGISTER_TOUCH_BYTES, &value[2], 1,
+                         IQS263_WINDOW_TIMEOUT, 0);
+    if (rc) {
+        goto error;
+    }
+
+    /* Keep the window open if there is queued work to pack into it */
+    last_op = (open == NULL || iqs263_xfer_count == 0);
+
+    /* Read the coordinates register to get slider coordinates */
+    rc = iqs263_i2c_read(IQS263_REGISTER_COORDINATES, &value[3], 3,
+                         IQS263_WINDOW_TIMEOUT, last_op);
+    if (rc) {
+        goto error;
+    }
+
+    if (open) {
+        *open = !last_op;
+    }
+
+    return 0;
+error:
+    return rc;
+}
+
+static int
+iqs263_xfer_put(uint8_t flags, uint8_t reg, uint8_t *buffer, uint8_t len,
+                iqs263_xfer_cb cb, void *arg)
+{
+    struct iqs263_xfer *xfer;
+    os_sr_t sr;
+
+    if (len == 0 || len > IQS263_XFER_MAX_LEN) {
+        return SYS_EINVAL;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    if (iqs263_xfer_count == MYNEWT_VAL(IQS263_XFER_QUEUE_SIZE)) {
+        OS_EXIT_CRITICAL(sr);
+#if MYNEWT_VAL(IQS263_STATS)
+        STATS_INC(g_iqs263stats, xfer_overflows);
+#endif
+        return SYS_ENOMEM;
+    }
+
+    xfer = &iqs263_xfer_queue[(iqs263_xfer_head + iqs263_xfer_count) %
+                              MYNEWT_VAL(IQS263_XFER_QUEUE_SIZE)];
+    xfer->flags = flags;
+    xfer->reg = reg;
+    xfer->len = len;
+    if (flags & IQS263_XFER_WRITE) {
+        memcpy(xfer->data, buffer, len);
+        xfer->buffer = NULL;
+    } else {
+        xfer->buffer = buffer;
+    }
+    xfer->cb = cb;
+    xfer->arg = arg;
+    iqs263_xfer_count++;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+/**
+ * Services queued transfers back to back in the current RDY window. Only the
+ * last transfer issues a STOP, which is what makes the chip close the window.
+ */
+static void
+iqs263_xfer_drain(void)
+{
+    struct iqs263_xfer *xfer;
+    iqs263_xfer_cb cb;
+    void *arg;
+    uint8_t budget;
+    uint8_t last_op;
+    os_sr_t sr;
+    int rc;
+
+    budget = MYNEWT_VAL(IQS263_XFER_PER_WINDOW);
+    while (budget && iqs263_xfer_count) {
+        budget--;
+        xfer = &iqs263_xfer_queue[iqs263_xfer_head];
+        last_op = (budget == 0 || iqs263_xfer_count == 1);
+
+        if (xfer->flags & IQS263_XFER_WRITE) {
+            rc = iqs263_i2c_write(xfer->reg, xfer->data, xfer->len,
+                                  IQS263_WINDOW_TIMEOUT, last_op);
+        } else {
+            rc = iqs263_i2c_read(xfer->reg, xfer->buffer, xfer->len,
+                                 IQS263_WINDOW_TIMEOUT, last_op);
+        }
+
+        cb = xfer->cb;
+        arg = xfer->arg;
+
+        OS_ENTER_CRITICAL(sr);
+        iqs263_xfer_head = (iqs263_xfer_head + 1) %
+                           MYNEWT_VAL(IQS263_XFER_QUEUE_SIZE);
+        iqs263_xfer_count--;
+        OS_EXIT_CRITICAL(sr);
+
+#if MYNEWT_VAL(IQS263_STATS)
+        STATS_INC(g_iqs263stats, xfers);
+#endif
+        if (cb) {
+            cb(rc, arg);
+        }
+
+        /* The window was ended, leave the rest for the next one */
+        if (rc) {
+            break;
+        }
+    }
+}
+
+static struct gpio_ring_pin iqs263_rdy_gp;
+
+/**
+ * @return The event queue driver events run on, the one RDY drains on
+ */
+struct os_eventq *
+iqs263_evq_get(void)
+{
+    return gpio_ring_evq_get();
+}
+
+static void
+iqs263_rdy_edge(struct gpio_ring_pin *gp, int level, uint32_t ts)
 {
     int rc;
     uint8_t data_buffer[6];
+    uint8_t open;
 
 #if MYNEWT_VAL(IQS263_STATS)
     STATS_INC(g_iqs263stats, irqs);
+    STATS_INC(g_iqs263stats, windows);
 #endif
 
-    rc = iqs263_event(data_buffer);
+    rc = iqs263_window_read_events(data_buffer, &open);
     if(rc){
         goto error;
     }
 
+    if (open) {
+        iqs263_xfer_drain();
+    }
+
     uint8_t events = data_buffer[1];
+    if (events & (IQS263_EVENT_MASK_TOUCH | IQS263_EVENT_MASK_SLIDE)) {
+        /* Stamped at the edge, not when this event got to run */
+        iqs263_gesture_feed(ts, data_buffer[3],
+                            data_buffer[2] & (IQS263_ACTIVE_CHANNELS_CH1 |
+                                              IQS263_ACTIVE_CHANNELS_CH2 |
+                                              IQS263_ACTIVE_CHANNELS_CH3));
+    }
+
     if(events & IQS263_EVENT_MASK_PROX)
     {
 #if MYNEWT_VAL(IQS263_STATS)
@@ -215,39 +584,64 @@ error:
     return;
 }
 
-static struct os_event gpio_ev = {
-    .ev_cb = interrupt_ev_cb,
-};
-
-static void
-my_gpio_irq(void *arg)
-{
-    os_eventq_put(os_eventq_dflt_get(), &gpio_ev);
-}
-
 int
-iqs263_write8(uint8_t reg, uint8_t value)
+iqs263_request_window(void)
 {
     int rc;
-    uint8_t payload[2] = { reg, value};
 
-    struct hal_i2c_master_data data_struct = {
-        .address = IQS263_ADDR,
-        .len = 2,
-        .buffer = payload
-    };
+    if (!iqs263_rdy_armed) {
+        return SYS_EINVAL;
+    }
 
-    rc = hal_i2c_master_write(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC, 1);
+    /* Pull RDY low to request a window, then hand the line back to the chip
+     * so the falling edge of the window it opens is caught as usual */
+    gpio_ring_pin_release(&iqs263_rdy_gp);
+    hal_gpio_init_out(IQS263_RDY, 0);
+    os_cputime_delay_usecs(MYNEWT_VAL(IQS263_RDY_FORCE_US));
+
+    rc = gpio_ring_pin_init(&iqs263_rdy_gp, IQS263_RDY,
+                            HAL_GPIO_TRIG_FALLING, HAL_GPIO_PULL_UP,
+                            iqs263_rdy_edge, NULL);
     if (rc) {
-        IQS263_ERR("Failed to write to 0x%02X:0x%02X with value 0x%02X\n",
-                       data_struct.address, reg, value);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
+        iqs263_rdy_armed = 0;
+        return rc;
     }
 
-    return rc;
+    return 0;
+}
+
+void
+iqs263_rdy_coalesce(const struct gpio_ring_coalesce *co)
+{
+    gpio_ring_pin_coalesce(&iqs263_rdy_gp, co);
+}
+
+int
+iqs263_queue_read(uint8_t reg, uint8_t *buffer, uint8_t len,
+                  iqs263_xfer_cb cb, void *arg)
+{
+    return iqs263_xfer_put(IQS263_XFER_READ, reg, buffer, len, cb, arg);
+}
+
+int
+iqs263_queue_write(uint8_t reg, uint8_t *buffer, uint8_t len,
+                   iqs263_xfer_cb cb, void *arg)
+{
+    return iqs263_xfer_put(IQS263_XFER_WRITE, reg, buffer, len, cb, arg);
+}
+
+/**
+ * Writes a single byte to the specified register
+ *
+ * @param The register address to write to
+ * @param The value to write
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+iqs263_write8(uint8_t reg, uint8_t value)
+{
+    return iqs263_i2c_write(reg, &value, 1, IQS263_WINDOW_TIMEOUT, 1);
 }
 
 /**
@@ -261,44 +655,7 @@ iqs263_write8(uint8_t reg, uint8_t value)
 int
 iqs263_writelen(uint8_t reg, uint8_t *buffer, uint8_t len)
 {
-    int rc;
-    uint8_t payload[9] = { reg, 0, 0, 0, 0, 0, 0, 0, 0};
-
-    struct hal_i2c_master_data data_struct = {
-        .address = IQS263_ADDR,
-        .len = 1,
-        .buffer = payload
-    };
-
-    memcpy(&payload[1], buffer, len);
-
-    /* Register write */
-    rc = hal_i2c_master_write(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 0);
-    if (rc) {
-        IQS263_ERR("I2C access failed at address 0x%02X:0x%02X\n", data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-        goto error;
-    }
-
-    memset(payload, 0, sizeof(payload));
-    data_struct.len = len;
-    rc = hal_i2c_master_write(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 1);
-
-    if (rc) {
-        IQS263_ERR("Failed to read from 0x%02X:0x%02X\n", data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-        goto error;
-    }
-
-    return 0;
-error:
-    return rc;
+    return iqs263_i2c_write(reg, buffer, len, IQS263_WINDOW_TIMEOUT, 1);
 }
 
 /**
@@ -312,42 +669,7 @@ error:
 int
 iqs263_read8(uint8_t reg, uint8_t *value)
 {
-    int rc;
-    uint8_t payload;
-
-    struct hal_i2c_master_data data_struct = {
-        .address = IQS263_ADDR,
-        .len = 1,
-        .buffer = &payload
-    };
-
-    /* Register write */
-    payload = reg;
-    rc = hal_i2c_master_write(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 0);
-    if (rc) {
-        IQS263_ERR("I2C register write failed at address 0x%02X:0x%02X\n",
-                   data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-        goto error;
-    }
-
-    /* Read one byte back */
-    payload = 0;
-    rc = hal_i2c_master_read(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                             OS_TICKS_PER_SEC / 10, 1);
-    *value = payload;
-    if (rc) {
-        IQS263_ERR("Failed to read from 0x%02X:0x%02X\n", data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-    }
-
-error:
-    return rc;
+    return iqs263_readlen(reg, value, 1);
 }
 
 /**
@@ -363,49 +685,10 @@ error:
 int
 iqs263_readlen(uint8_t reg, uint8_t *buffer, uint8_t len)
 {
-    int rc;
-    uint8_t payload[9] = { reg, 0, 0, 0, 0, 0, 0, 0, 0};
-
-    struct hal_i2c_master_data data_struct = {
-        .address = IQS263_ADDR,
-        .len = 1,
-        .buffer = payload
-    };
-
     /* Clear the supplied buffer */
     memset(buffer, 0, len);
 
-    /* Register write */
-    rc = hal_i2c_master_write(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                              OS_TICKS_PER_SEC / 10, 0);
-    if (rc) {
-        IQS263_ERR("I2C access failed at address 0x%02X:0x%02X\n", data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-        goto error;
-    }
-
-    /* Read len bytes back */
-    memset(payload, 0, sizeof(payload));
-    data_struct.len = len;
-    rc = hal_i2c_master_read(MYNEWT_VAL(IQS263_I2CBUS), &data_struct,
-                             OS_TICKS_PER_SEC / 10, 1);
-
-    if (rc) {
-        IQS263_ERR("Failed to read from 0x%02X:0x%02X\n", data_struct.address, reg);
-#if MYNEWT_VAL(IQS263_STATS)
-        STATS_INC(g_iqs263stats, errors);
-#endif
-        goto error;
-    }
-
-    /* Copy the I2C results into the supplied buffer */
-    memcpy(buffer, payload, len);
-
-    return 0;
-error:
-    return rc;
+    return iqs263_i2c_read(reg, buffer, len, IQS263_WINDOW_TIMEOUT, 1);
 }
 
 int
@@ -469,10 +752,7 @@ iqs263_device_init()
     os_time_delay(5 * (OS_TICKS_PER_SEC / 100));
 
     /* Setup touch and prox thresholds for each channel */
-    data_buffer[0] = 0x08; //PROX_THRESHOLD
-    data_buffer[1] = 0x20; //TOUCH_THRESHOLD_CH1
-    data_buffer[2] = 0x20; //TOUCH_THRESHOLD_CH2
-    data_buffer[3] = 0x20; //TOUCH_THRESHOLD_CH3
+    iqs263_tune_get_thresholds(data_buffer); //PROX_THRESHOLD, TOUCH_THRESHOLD_CH1..3
     data_buffer[4] = 0x03; //MOVEMENT_THRESHOLD
     data_buffer[5] = 0x00; //RESEED_BLOCK
     data_buffer[6] = 0x14; //HALT_TIME
@@ -484,12 +764,12 @@ iqs263_device_init()
     }
     os_time_delay(5 * (OS_TICKS_PER_SEC / 100));
 
-    /* Set the ATI Targets (Target Counts) */
-    // data_buffer[0] = 0x00; //Low power timer value x 16ms
-    data_buffer[0] = 0x30; //ATI target for touch value x 8
-    data_buffer[1] = 0x40; //ATI target for proximity value x 8
+    /* Set the ATI Targets (Target Counts), start at full-rate scanning */
+    data_buffer[0] = 0x00; //Low power timer value x 16ms
+    data_buffer[1] = 0x30; //ATI target for touch value x 8
+    data_buffer[2] = 0x40; //ATI target for proximity value x 8
     rc = iqs263_writelen(IQS263_REGISTER_TIMINGS_AND_TARGETS,
-        data_buffer, 2);
+        data_buffer, 3);
     if (rc) {
         goto error;
     }
@@ -577,6 +857,12 @@ iqs263_device_init()
     data_buffer[1] = dogs;
     data_buffer[2] = IQS263_PROX_SETTINGS_2_MOVEMENT; //PROX_SETTINGS_2
     data_buffer[3] = 0x00; //PROX_SETTINGS_3
+#if MYNEWT_VAL(IQS263_GESTURE)
+    /* Gestures are recognized in software from touch and slide reports */
+    data_buffer[4] = IQS263_EVENT_MASK_PROX |
+                        IQS263_EVENT_MASK_TOUCH |
+                        IQS263_EVENT_MASK_SLIDE; //EVENT MASK
+#else
     data_buffer[4] = IQS263_EVENT_MASK_PROX |
                         // IQS263_EVENT_MASK_TOUCH | 
                         // IQS263_EVENT_MASK_SLIDE |
@@ -585,6 +871,7 @@ iqs263_device_init()
                         // IQS263_EVENT_MASK_TAP |
                         // IQS263_EVENT_MASK_FLICK_RIGHT |
                         IQS263_EVENT_MASK_FLICK_LEFT; //EVENT MASK
+#endif
 
     rc = iqs263_writelen(IQS263_REGISTER_PROX_SETTINGS,
         data_buffer, 5);
@@ -592,8 +879,14 @@ iqs263_device_init()
         goto error;
     }
 
-    hal_gpio_irq_init(IQS263_RDY, my_gpio_irq, NULL, HAL_GPIO_TRIG_FALLING, HAL_GPIO_PULL_UP);
-    hal_gpio_irq_enable(IQS263_RDY);
+    gpio_ring_pin_release(&iqs263_rdy_gp);
+    rc = gpio_ring_pin_init(&iqs263_rdy_gp, IQS263_RDY,
+                            HAL_GPIO_TRIG_FALLING, HAL_GPIO_PULL_UP,
+                            iqs263_rdy_edge, NULL);
+    if (rc) {
+        goto error;
+    }
+    iqs263_rdy_armed = 1;
     return (0);
 error:
     hal_gpio_init_in(IQS263_RDY, HAL_GPIO_PULL_NONE);
@@ -629,16 +922,110 @@ iqs263_init(struct os_dev *dev, void *arg)
     SYSINIT_PANIC_ASSERT(rc == 0);
 #endif
 
+#if MYNEWT_VAL(IQS263_CLI)
+    rc = iqs263_shell_init();
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+
+    os_callout_init(&iqs263_lp_callout, iqs263_evq_get(),
+                    iqs263_lp_timeout, NULL);
+
+    rc = iqs263_default_cfg(&iqs263cfg);
+    if (rc) {
+        goto error;
+    }
+
     rc = iqs263_device_init();
     if (rc) {
         goto error;
     }
 
+    rc = iqs263_config(&iqs263cfg);
+    if (rc) {
+        goto error;
+    }
+
     return (0);
 error:
     return (rc);
 }
 
+int
+iqs263_default_cfg(struct iqs263_cfg *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+
+    cfg->lp_timer = MYNEWT_VAL(IQS263_LP_TIMER);
+    cfg->lp_idle_ms = MYNEWT_VAL(IQS263_LP_IDLE_MS);
+    cfg->tune_period_ms = MYNEWT_VAL(IQS263_TUNE_PERIOD_MS);
+    cfg->prox_thr_min = MYNEWT_VAL(IQS263_TUNE_PROX_MIN);
+    cfg->prox_thr_max = MYNEWT_VAL(IQS263_TUNE_PROX_MAX);
+    cfg->touch_thr_min = MYNEWT_VAL(IQS263_TUNE_TOUCH_MIN);
+    cfg->touch_thr_max = MYNEWT_VAL(IQS263_TUNE_TOUCH_MAX);
+    cfg->gesture.tap_max_ms = 200;
+    cfg->gesture.double_tap_gap_ms = 250;
+    cfg->gesture.long_press_ms = 800;
+    cfg->gesture.swipe_min_dist = 40; //of 255 across the slider
+    cfg->gesture.flick_min_speed = 800;
+    cfg->gesture_cb = NULL;
+
+    return 0;
+}
+
+int
+iqs263_config(struct iqs263_cfg *cfg)
+{
+    os_time_t ticks;
+    int rc;
+
+    /* Overwrite the configuration data, init passes the stored one */
+    if (cfg != &iqs263cfg) {
+        memcpy(&iqs263cfg, cfg, sizeof(*cfg));
+    }
+
+    rc = iqs263_tune_config(&iqs263cfg);
+    if (rc) {
+        return rc;
+    }
+
+    rc = iqs263_gesture_config(&iqs263cfg.gesture, iqs263cfg.gesture_cb);
+    if (rc) {
+        return rc;
+    }
+
+    if (iqs263cfg.lp_timer == 0) {
+        os_callout_stop(&iqs263_lp_callout);
+        rc = iqs263_lp_set(0);
+        goto window;
+    }
+
+    rc = os_time_ms_to_ticks(iqs263cfg.lp_idle_ms, &ticks);
+    if (rc) {
+        return SYS_EINVAL;
+    }
+
+    /* A new low-power interval takes effect on the next idle switch */
+    if (iqs263_lp_active) {
+        iqs263_lp_active = 0;
+        rc = iqs263_lp_set(1);
+        goto window;
+    }
+    os_callout_reset(&iqs263_lp_callout, ticks);
+
+    return 0;
+window:
+    if (rc) {
+        return rc;
+    }
+
+    /* Idle in low power the chip may not open a window for a long time */
+    if (iqs263_xfer_count) {
+        return iqs263_request_window();
+    }
+
+    return 0;
+}
+
 
 // int
 // bma250_config(struct bma250 *lsm, struct bma250_cfg *cfg)
@@ -668,34 +1055,16 @@ error:
 //     return (rc);
 // }
 
+/**
+ * Read the event state from the chip. Must be called while a RDY window is
+ * open, the three register blocks are read without closing it in between.
+ *
+ * @param Buffer of 6 bytes to read into
+ *
+ * @return 0 on success and non-zero on failure
+ */
 int
 iqs263_event(uint8_t *value)
 {
-    uint8_t data_buffer[6];
-    int rc;
-
-    /* Read the system flags register to enable all events */
-    rc = iqs263_readlen(IQS263_REGISTER_SYS_FLAGS, &data_buffer[0], 2);
-    if (rc) {
-        goto error;
-    }
-    os_time_delay(5 * (OS_TICKS_PER_SEC / 100));
-
-    /* Read from the touch bytes register to enable touch events */
-    rc = iqs263_readlen(IQS263_REGISTER_TOUCH_BYTES, &data_buffer[2], 1);
-    if (rc) {
-        goto error;
-    }
-    os_time_delay(5 * (OS_TICKS_PER_SEC / 100));
-
-    /* Read the coordinates register to get slider coordinates */
-    rc = iqs263_readlen(IQS263_REGISTER_COORDINATES, &data_buffer[3], 3);
-    if (rc) {
-        goto error;
-    }
-
-    memcpy(data_buffer, value, 6);
-    return (0);
-error:
-    return (rc);
-}
\ No newline at end of file
+    return iqs263_window_read_events(value, NULL);
+}
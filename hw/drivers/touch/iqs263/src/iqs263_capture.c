@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "os/os_cputime.h"
+#include "sysinit/sysinit.h"
+#include "iqs263/iqs263.h"
+#include "iqs263_priv.h"
+
+/*
+ * Tuning capture: COUNTS, LTA and DELTAS are sampled at a fixed rate through
+ * the RDY window queue and stored as raw frames in a ring buffer. A sample
+ * that cannot be taken (ring full, previous sample still in flight or a
+ * failed transfer) is counted as dropped.
+ */
+
+static struct iqs263_capture_frame
+    iqs263_capture_ring[MYNEWT_VAL(IQS263_CAPTURE_FRAMES)];
+static uint16_t iqs263_capture_head;
+static uint16_t iqs263_capture_count;
+
+static struct os_callout iqs263_capture_callout;
+static os_time_t iqs263_capture_period;
+static os_time_t iqs263_capture_start_time;
+static os_time_t iqs263_capture_stop_time;
+static uint8_t iqs263_capture_running;
+
+/* Frame being filled by the queued reads */
+static struct iqs263_capture_frame iqs263_capture_work;
+static uint8_t iqs263_capture_remaining;
+static int iqs263_capture_rc;
+
+static struct iqs263_capture_stats iqs263_capture_stats;
+
+static void
+iqs263_capture_commit(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (iqs263_capture_rc == 0 &&
+        iqs263_capture_count < MYNEWT_VAL(IQS263_CAPTURE_FRAMES)) {
+        iqs263_capture_ring[(iqs263_capture_head + iqs263_capture_count) %
+                            MYNEWT_VAL(IQS263_CAPTURE_FRAMES)] =
+            iqs263_capture_work;
+        iqs263_capture_count++;
+        iqs263_capture_stats.frames++;
+    } else {
+        iqs263_capture_stats.dropped++;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+static void
+iqs263_capture_read_cb(int rc, void *arg)
+{
+    if (rc) {
+        iqs263_capture_rc = rc;
+    }
+
+    if (--iqs263_capture_remaining == 0) {
+        iqs263_capture_commit();
+    }
+}
+
+static void
+iqs263_capture_sample(struct os_event *ev)
+{
+    static const uint8_t regs[] = {
+        IQS263_REGISTER_COUNTS,
+        IQS263_REGISTER_LTA,
+        IQS263_REGISTER_DELTAS
+    };
+    struct iqs263_capture_frame *frame;
+    uint8_t *dst[3];
+    uint8_t queued;
+    int rc;
+    int i;
+
+    if (!iqs263_capture_running) {
+        return;
+    }
+    os_callout_reset(&iqs263_capture_callout, iqs263_capture_period);
+
+    /* Previous sample has not been serviced yet, or nowhere to put it */
+    if (iqs263_capture_remaining ||
+        iqs263_capture_count == MYNEWT_VAL(IQS263_CAPTURE_FRAMES)) {
+        iqs263_capture_stats.dropped++;
+        return;
+    }
+
+    frame = &iqs263_capture_work;
+    frame->ts = os_cputime_get32();
+    iqs263_capture_rc = 0;
+
+    /* Channel words arrive low byte first, same as the nRF51 */
+    dst[0] = (uint8_t *)frame->counts;
+    dst[1] = (uint8_t *)frame->lta;
+    dst[2] = (uint8_t *)frame->deltas;
+
+    iqs263_capture_remaining = 3;
+    queued = 0;
+    for (i = 0; i < 3; i++) {
+        rc = iqs263_queue_read(regs[i], dst[i], 2 * IQS263_CHANNELS,
+                               iqs263_capture_read_cb, NULL);
+        if (rc) {
+            break;
+        }
+        queued++;
+    }
+
+    if (queued < 3) {
+        /* Reads already queued still complete into the frame, which is
+         * then dropped */
+        iqs263_capture_rc = SYS_ENOMEM;
+        iqs263_capture_remaining -= 3 - queued;
+        if (iqs263_capture_remaining == 0) {
+            iqs263_capture_commit();
+        }
+        return;
+    }
+
+    iqs263_request_window();
+}
+
+int
+iqs263_capture_start(uint16_t rate_hz)
+{
+    if (rate_hz == 0 || rate_hz > OS_TICKS_PER_SEC) {
+        return SYS_EINVAL;
+    }
+
+    /* The callout may be queued, it is only set up again once stopped */
+    if (iqs263_capture_running) {
+        return SYS_EALREADY;
+    }
+
+    os_callout_init(&iqs263_capture_callout, iqs263_evq_get(),
+                    iqs263_capture_sample, NULL);
+
+    memset(&iqs263_capture_stats, 0, sizeof(iqs263_capture_stats));
+    iqs263_capture_head = 0;
+    iqs263_capture_count = 0;
+    iqs263_capture_period = OS_TICKS_PER_SEC / rate_hz;
+    iqs263_capture_start_time = os_time_get();
+    iqs263_capture_running = 1;
+
+    return os_callout_reset(&iqs263_capture_callout, iqs263_capture_period);
+}
+
+int
+iqs263_capture_stop(void)
+{
+    if (!iqs263_capture_running) {
+        return SYS_EALREADY;
+    }
+
+    iqs263_capture_running = 0;
+    iqs263_capture_stop_time = os_time_get();
+    os_callout_stop(&iqs263_capture_callout);
+
+    return 0;
+}
+
+int
+iqs263_capture_read(struct iqs263_capture_frame *frame)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (iqs263_capture_count == 0) {
+        OS_EXIT_CRITICAL(sr);
+        return SYS_ENOENT;
+    }
+    *frame = iqs263_capture_ring[iqs263_capture_head];
+    iqs263_capture_head = (iqs263_capture_head + 1) %
+                          MYNEWT_VAL(IQS263_CAPTURE_FRAMES);
+    iqs263_capture_count--;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+int
+iqs263_capture_get_stats(struct iqs263_capture_stats *stats)
+{
+    os_time_t end;
+
+    end = iqs263_capture_running ? os_time_get() : iqs263_capture_stop_time;
+
+    *stats = iqs263_capture_stats;
+    stats->elapsed_ms = os_time_ticks_to_ms32(end - iqs263_capture_start_time);
+
+    return 0;
+}
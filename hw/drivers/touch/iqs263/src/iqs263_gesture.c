@@ -0,0 +1,289 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "os/os_cputime.h"
+#include "sysinit/sysinit.h"
+#include "iqs263/iqs263.h"
+#include "iqs263_priv.h"
+
+/*
+ * Software gesture recognizer fed with timestamped slider reports. Each
+ * report is handled in constant time against a fixed-size state. Times are
+ * os_cputime ticks from the RDY edge and only their differences are turned
+ * into ms, so the recognizer keeps working across a wrap; a single
+ * callout covers the two timeouts that do not come with a report (long
+ * press while held, and the end of the double-tap window).
+ */
+
+enum iqs263_gesture_state {
+    IQS263_GESTURE_STATE_IDLE,
+    IQS263_GESTURE_STATE_DOWN,      /* touching, not moved far yet */
+    IQS263_GESTURE_STATE_MOVING,    /* touching, past the swipe distance */
+    IQS263_GESTURE_STATE_HELD       /* long press reported, wait for up */
+};
+
+static struct iqs263_gesture_cfg *iqs263_gesture_cfg;
+static os_event_fn *iqs263_gesture_cb;
+
+static uint8_t iqs263_gesture_state;
+static uint8_t iqs263_gesture_tap_pending;
+static uint8_t iqs263_gesture_x_down;
+static uint8_t iqs263_gesture_x_last;
+static uint32_t iqs263_gesture_t_down;
+static uint32_t iqs263_gesture_t_tap;
+
+static uint32_t
+iqs263_gesture_ms_since(uint32_t then, uint32_t now)
+{
+    return os_cputime_ticks_to_usecs(now - then) / 1000;
+}
+
+static struct os_callout iqs263_gesture_callout;
+
+static struct iqs263_gesture_event gesture_event;
+static struct os_event gesture_ev = {
+    .ev_arg = &gesture_event,
+};
+
+/* A held back tap has its own event, it is often reported right before
+ * the gesture that follows it */
+static struct iqs263_gesture_event tap_event;
+static struct os_event tap_ev = {
+    .ev_arg = &tap_event,
+};
+
+static void
+iqs263_gesture_post(enum iqs263_gesture type, uint8_t start, uint8_t end,
+                    uint32_t duration_ms)
+{
+    gesture_event.type = type;
+    gesture_event.start = start;
+    gesture_event.end = end;
+    gesture_event.duration_ms = duration_ms;
+
+    if (gesture_ev.ev_cb) {
+        os_eventq_put(iqs263_evq_get(), &gesture_ev);
+    }
+}
+
+/* Reports the held back tap once it can no longer become a double tap */
+static void
+iqs263_gesture_flush_tap(void)
+{
+    if (!iqs263_gesture_tap_pending) {
+        return;
+    }
+    iqs263_gesture_tap_pending = 0;
+
+    if (tap_ev.ev_cb) {
+        os_eventq_put(iqs263_evq_get(), &tap_ev);
+    }
+}
+
+static void
+iqs263_gesture_arm(uint32_t ms)
+{
+    os_time_t ticks;
+
+    if (os_time_ms_to_ticks(ms, &ticks) == 0) {
+        os_callout_reset(&iqs263_gesture_callout, ticks);
+    }
+}
+
+static void
+iqs263_gesture_timeout(struct os_event *ev)
+{
+    struct iqs263_gesture_cfg *cfg;
+
+    cfg = iqs263_gesture_cfg;
+    if (cfg == NULL) {
+        return;
+    }
+
+    switch (iqs263_gesture_state) {
+    case IQS263_GESTURE_STATE_DOWN:
+        iqs263_gesture_state = IQS263_GESTURE_STATE_HELD;
+        iqs263_gesture_flush_tap();
+        iqs263_gesture_post(IQS263_GESTURE_LONG_PRESS, iqs263_gesture_x_down,
+                            iqs263_gesture_x_last, cfg->long_press_ms);
+        break;
+    case IQS263_GESTURE_STATE_IDLE:
+        /* No second tap inside the window */
+        iqs263_gesture_flush_tap();
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+iqs263_gesture_release(struct iqs263_gesture_cfg *cfg, uint32_t now)
+{
+    uint32_t duration;
+    uint32_t speed;
+    int dist;
+    uint8_t right;
+
+    duration = iqs263_gesture_ms_since(iqs263_gesture_t_down, now);
+    dist = iqs263_gesture_x_last - iqs263_gesture_x_down;
+    right = dist > 0;
+    if (dist < 0) {
+        dist = -dist;
+    }
+
+    switch (iqs263_gesture_state) {
+    case IQS263_GESTURE_STATE_MOVING:
+        /* Slider units per second */
+        speed = (dist * 1000) / (duration ? duration : 1);
+        if (speed >= cfg->flick_min_speed) {
+            iqs263_gesture_post(right ? IQS263_GESTURE_FLICK_RIGHT :
+                                        IQS263_GESTURE_FLICK_LEFT,
+                                iqs263_gesture_x_down, iqs263_gesture_x_last,
+                                duration);
+        } else {
+            iqs263_gesture_post(right ? IQS263_GESTURE_SWIPE_RIGHT :
+                                        IQS263_GESTURE_SWIPE_LEFT,
+                                iqs263_gesture_x_down, iqs263_gesture_x_last,
+                                duration);
+        }
+        break;
+    case IQS263_GESTURE_STATE_DOWN:
+        if (duration > cfg->tap_max_ms) {
+            iqs263_gesture_flush_tap();
+            break;
+        }
+        if (iqs263_gesture_tap_pending) {
+            iqs263_gesture_tap_pending = 0;
+            iqs263_gesture_post(IQS263_GESTURE_DOUBLE_TAP,
+                                iqs263_gesture_x_down, iqs263_gesture_x_last,
+                                iqs263_gesture_ms_since(iqs263_gesture_t_tap,
+                                                        now));
+        } else if (cfg->double_tap_gap_ms == 0) {
+            iqs263_gesture_post(IQS263_GESTURE_TAP, iqs263_gesture_x_down,
+                                iqs263_gesture_x_last, duration);
+        } else {
+            /* Hold the tap back until the double-tap window closes */
+            iqs263_gesture_tap_pending = 1;
+            iqs263_gesture_t_tap = iqs263_gesture_t_down;
+            tap_event.type = IQS263_GESTURE_TAP;
+            tap_event.start = iqs263_gesture_x_down;
+            tap_event.end = iqs263_gesture_x_last;
+            tap_event.duration_ms = duration;
+            iqs263_gesture_arm(cfg->double_tap_gap_ms);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    os_callout_stop(&iqs263_gesture_callout);
+}
+
+int
+iqs263_gesture_feed(uint32_t now, uint8_t coord, uint8_t touching)
+{
+    struct iqs263_gesture_cfg *cfg;
+    int dist;
+
+    cfg = iqs263_gesture_cfg;
+    if (cfg == NULL) {
+        return SYS_EINVAL;
+    }
+
+    if (!touching) {
+        if (iqs263_gesture_state != IQS263_GESTURE_STATE_IDLE) {
+            iqs263_gesture_release(cfg, now);
+            iqs263_gesture_state = IQS263_GESTURE_STATE_IDLE;
+        }
+        return 0;
+    }
+
+    switch (iqs263_gesture_state) {
+    case IQS263_GESTURE_STATE_IDLE:
+        /* A pending tap that has timed out without the callout running
+         * yet is not a double tap */
+        if (iqs263_gesture_tap_pending &&
+            iqs263_gesture_ms_since(iqs263_gesture_t_tap, now) >
+            cfg->double_tap_gap_ms + cfg->tap_max_ms) {
+            iqs263_gesture_flush_tap();
+        }
+        iqs263_gesture_state = IQS263_GESTURE_STATE_DOWN;
+        iqs263_gesture_t_down = now;
+        iqs263_gesture_x_down = coord;
+        iqs263_gesture_x_last = coord;
+        if (cfg->long_press_ms) {
+            iqs263_gesture_arm(cfg->long_press_ms);
+        } else {
+            /* The release settles a pending tap, the double-tap window
+             * must not fire while down and be taken for a long press */
+            os_callout_stop(&iqs263_gesture_callout);
+        }
+        break;
+    case IQS263_GESTURE_STATE_DOWN:
+        iqs263_gesture_x_last = coord;
+        dist = coord - iqs263_gesture_x_down;
+        if (dist < 0) {
+            dist = -dist;
+        }
+        if (dist >= cfg->swipe_min_dist) {
+            iqs263_gesture_state = IQS263_GESTURE_STATE_MOVING;
+            iqs263_gesture_flush_tap();
+            os_callout_stop(&iqs263_gesture_callout);
+        }
+        break;
+    default:
+        iqs263_gesture_x_last = coord;
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Installs the gesture timings and callback
+ *
+ * @param Gesture timings, must stay valid while recognizing
+ * @param Callback posted with a struct iqs263_gesture_event as ev_arg,
+ *        NULL disables the recognizer
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+iqs263_gesture_config(struct iqs263_gesture_cfg *cfg, os_event_fn *cb)
+{
+    os_callout_stop(&iqs263_gesture_callout);
+    os_callout_init(&iqs263_gesture_callout, iqs263_evq_get(),
+                    iqs263_gesture_timeout, NULL);
+    iqs263_gesture_state = IQS263_GESTURE_STATE_IDLE;
+    iqs263_gesture_tap_pending = 0;
+
+    iqs263_gesture_cb = cb;
+    gesture_ev.ev_cb = cb;
+    tap_ev.ev_cb = cb;
+    iqs263_gesture_cfg = cb ? cfg : NULL;
+
+    return 0;
+}
@@ -20,6 +20,8 @@
 #ifndef __IQS263_PRIV_H__
 #define __IQS263_PRIV_H__
 
+#include "iqs263/iqs263.h"
+
 #define IQS263_ADDR                     0x44
 #define IQS263_PROD_NUM                 0x3C
 #define IQS263_VERSION_NUM              0x00
@@ -121,6 +123,42 @@ extern "C" {
 #define IQS263_EVENT_MASK_FLICK_RIGHT             (0x01 << 6)
 #define IQS263_EVENT_MASK_FLICK_LEFT              (0x01 << 7)
 
+/* Thresholds programmed until the tuner has learnt better ones */
+#define IQS263_DEFAULT_PROX_THRESHOLD             (0x08)
+#define IQS263_DEFAULT_TOUCH_THRESHOLD            (0x20)
+
+/* Largest register block on the chip (THRESHOLDS) */
+#define IQS263_XFER_MAX_LEN                       (8)
+
+#define IQS263_XFER_READ                          (0x01 << 0)
+#define IQS263_XFER_WRITE                         (0x01 << 1)
+
+/*
+ * A register transfer waiting for the next RDY window. Reads land directly
+ * in the caller's buffer, writes keep their own copy of the payload.
+ */
+struct iqs263_xfer {
+    uint8_t flags;
+    uint8_t reg;
+    uint8_t len;
+    uint8_t data[IQS263_XFER_MAX_LEN];
+    uint8_t *buffer;
+    iqs263_xfer_cb cb;
+    void *arg;
+};
+
+void
+iqs263_tune_get_thresholds(uint8_t *thresholds);
+
+struct os_eventq *
+iqs263_evq_get(void);
+
+int
+iqs263_tune_config(struct iqs263_cfg *cfg);
+
+int
+iqs263_gesture_config(struct iqs263_gesture_cfg *cfg, os_event_fn *cb);
+
 #ifdef __cplusplus
 }
 #endif
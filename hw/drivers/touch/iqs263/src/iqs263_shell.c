@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "sysinit/sysinit.h"
+#include "console/console.h"
+#include "shell/shell.h"
+#include "sensor/sensor.h"
+#include "iqs263/iqs263.h"
+#include "iqs263_priv.h"
+
+#if MYNEWT_VAL(IQS263_CLI)
+
+static int iqs263_shell_cmd(int argc, char **argv);
+
+static struct shell_cmd iqs263_shell_cmd_struct = {
+    .sc_cmd = "iqs263",
+    .sc_cmd_func = iqs263_shell_cmd
+};
+
+static int
+iqs263_shell_err_too_many_args(char *cmd_name)
+{
+    console_printf("Error: too many arguments for command \"%s\"\n",
+                   cmd_name);
+    return EINVAL;
+}
+
+static int
+iqs263_shell_err_unknown_arg(char *cmd_name)
+{
+    console_printf("Error: unknown argument \"%s\"\n",
+                   cmd_name);
+    return EINVAL;
+}
+
+static int
+iqs263_shell_err_invalid_arg(char *cmd_name)
+{
+    console_printf("Error: invalid argument \"%s\"\n",
+                   cmd_name);
+    return EINVAL;
+}
+
+static int
+iqs263_shell_help(void)
+{
+    console_printf("%s cmd [flags...]\n", iqs263_shell_cmd_struct.sc_cmd);
+    console_printf("cmd:\n");
+    console_printf("\tcapture start [rate_hz]\n");
+    console_printf("\tcapture stop\n");
+    console_printf("\tcapture dump\n");
+
+    return 0;
+}
+
+static void
+iqs263_shell_print_words(const uint16_t *words)
+{
+    int i;
+
+    for (i = 0; i < IQS263_CHANNELS; i++) {
+        console_printf("%04X", words[i]);
+    }
+}
+
+/* One hex encoded binary frame per line: ts, counts, lta, deltas */
+static int
+iqs263_shell_capture_dump(void)
+{
+    struct iqs263_capture_frame frame;
+    struct iqs263_capture_stats stats;
+    uint32_t rate;
+
+    while (iqs263_capture_read(&frame) == 0) {
+        console_printf("%08lX", (unsigned long)frame.ts);
+        iqs263_shell_print_words(frame.counts);
+        iqs263_shell_print_words(frame.lta);
+        iqs263_shell_print_words(frame.deltas);
+        console_printf("\n");
+    }
+
+    iqs263_capture_get_stats(&stats);
+
+    /* Achieved rate in hundredths of a Hz */
+    rate = 0;
+    if (stats.elapsed_ms) {
+        rate = ((uint64_t)stats.frames * 100000) / stats.elapsed_ms;
+    }
+    console_printf("frames %lu dropped %lu rate %lu.%02lu Hz\n",
+                   (unsigned long)stats.frames,
+                   (unsigned long)stats.dropped,
+                   (unsigned long)(rate / 100),
+                   (unsigned long)(rate % 100));
+
+    return 0;
+}
+
+static int
+iqs263_shell_cmd_capture(int argc, char **argv)
+{
+    long val;
+    int rc;
+
+    if (argc < 3) {
+        return iqs263_shell_help();
+    }
+
+    if (argc > 4) {
+        return iqs263_shell_err_too_many_args(argv[2]);
+    }
+
+    if (strcmp(argv[2], "start") == 0) {
+        val = 10;
+        if (argc == 4) {
+            if (sensor_shell_stol(argv[3], 1, OS_TICKS_PER_SEC, &val)) {
+                return iqs263_shell_err_invalid_arg(argv[3]);
+            }
+        }
+        rc = iqs263_capture_start((uint16_t)val);
+        if (rc) {
+            console_printf("Start failed %d\n", rc);
+        }
+        return rc;
+    }
+
+    if (strcmp(argv[2], "stop") == 0) {
+        return iqs263_capture_stop();
+    }
+
+    if (strcmp(argv[2], "dump") == 0) {
+        return iqs263_shell_capture_dump();
+    }
+
+    return iqs263_shell_err_unknown_arg(argv[2]);
+}
+
+static int
+iqs263_shell_cmd(int argc, char **argv)
+{
+    if (argc == 1) {
+        return iqs263_shell_help();
+    }
+
+    /* Tuning capture command */
+    if (argc > 1 && strcmp(argv[1], "capture") == 0) {
+        return iqs263_shell_cmd_capture(argc, argv);
+    }
+
+    return iqs263_shell_err_unknown_arg(argv[1]);
+}
+
+int
+iqs263_shell_init(void)
+{
+    int rc;
+
+    rc = shell_cmd_register(&iqs263_shell_cmd_struct);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+    return rc;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "defs/error.h"
+#include "os/os.h"
+#include "sysinit/sysinit.h"
+#include "iqs263/iqs263.h"
+#include "iqs263_priv.h"
+
+/*
+ * Online threshold tuner. Deltas, LTA and the touch bytes are sampled
+ * periodically through the RDY window queue. Per channel, a running noise
+ * floor (mean |delta| while untouched) and touch amplitude (mean delta while
+ * touched) are kept as 28.4 fixed point moving averages. The threshold is
+ * placed halfway between the two, or at a multiple of the noise floor until
+ * a touch has been seen, and is rewritten when it drifts past the
+ * hysteresis.
+ *
+ * The proximity threshold (CH0) is in counts, the touch thresholds (CH1-3)
+ * are a fraction of LTA in 1/256 steps.
+ */
+
+#define IQS263_TUNE_NOISE_SHIFT     (4)
+#define IQS263_TUNE_AMP_SHIFT       (3)
+
+struct iqs263_tune_chan {
+    uint32_t noise_q4;
+    uint32_t amp_q4;
+    uint16_t quiet_samples;
+    uint8_t amp_valid;
+};
+
+static struct iqs263_tune_chan iqs263_tune_chans[IQS263_CHANNELS];
+
+/* Thresholds as last written to the chip: prox, touch CH1..CH3 */
+static uint8_t iqs263_thresholds[IQS263_CHANNELS] = {
+    IQS263_DEFAULT_PROX_THRESHOLD,
+    IQS263_DEFAULT_TOUCH_THRESHOLD,
+    IQS263_DEFAULT_TOUCH_THRESHOLD,
+    IQS263_DEFAULT_TOUCH_THRESHOLD
+};
+static uint8_t iqs263_tune_new[IQS263_CHANNELS];
+
+static struct iqs263_cfg *iqs263_tune_cfg;
+static struct os_callout iqs263_tune_callout;
+static os_time_t iqs263_tune_period;
+
+static uint8_t iqs263_tune_touch[2];
+static uint16_t iqs263_tune_deltas[IQS263_CHANNELS];
+static uint16_t iqs263_tune_lta[IQS263_CHANNELS];
+static uint8_t iqs263_tune_remaining;
+static int iqs263_tune_rc;
+
+static uint8_t
+iqs263_tune_clamp(uint32_t val, uint8_t min, uint8_t max)
+{
+    if (val < min) {
+        return min;
+    }
+    if (val > max) {
+        return max;
+    }
+    return val;
+}
+
+static void
+iqs263_tune_write_cb(int rc, void *arg)
+{
+    if (rc == 0) {
+        memcpy(iqs263_thresholds, iqs263_tune_new, sizeof(iqs263_thresholds));
+    }
+}
+
+/**
+ * Folds one delta sample into the running statistics of a channel
+ *
+ * @param The channel state
+ * @param The channel delta
+ * @param Whether the chip reports the channel as touched
+ */
+static void
+iqs263_tune_update_chan(struct iqs263_tune_chan *chan, int16_t delta,
+                        uint8_t touched)
+{
+    int32_t mag;
+
+    mag = (delta < 0 ? -delta : delta) << 4;
+
+    if (touched) {
+        if (!chan->amp_valid) {
+            chan->amp_q4 = mag;
+            chan->amp_valid = 1;
+        } else {
+            chan->amp_q4 += (mag - (int32_t)chan->amp_q4) >>
+                            IQS263_TUNE_AMP_SHIFT;
+        }
+        return;
+    }
+
+    if (chan->quiet_samples == 0) {
+        chan->noise_q4 = mag;
+    } else {
+        chan->noise_q4 += (mag - (int32_t)chan->noise_q4) >>
+                          IQS263_TUNE_NOISE_SHIFT;
+    }
+    if (chan->quiet_samples < UINT16_MAX) {
+        chan->quiet_samples++;
+    }
+}
+
+/**
+ * Target threshold of a channel in delta counts, 0 if not known yet
+ */
+static uint32_t
+iqs263_tune_target(struct iqs263_tune_chan *chan)
+{
+    uint32_t noise;
+    uint32_t amp;
+
+    if (chan->quiet_samples < MYNEWT_VAL(IQS263_TUNE_WARMUP)) {
+        return 0;
+    }
+
+    noise = chan->noise_q4 >> 4;
+    if (chan->amp_valid) {
+        amp = chan->amp_q4 >> 4;
+        if (amp > noise) {
+            return (noise + amp) / 2;
+        }
+    }
+
+    return noise * MYNEWT_VAL(IQS263_TUNE_NOISE_MULT);
+}
+
+static void
+iqs263_tune_evaluate(void)
+{
+    struct iqs263_cfg *cfg;
+    uint32_t target;
+    uint8_t changed;
+    int diff;
+    int i;
+
+    cfg = iqs263_tune_cfg;
+
+    /* TOUCH_BYTES: CH0 is the proximity channel, CH1-3 are touch */
+    for (i = 0; i < IQS263_CHANNELS; i++) {
+        iqs263_tune_update_chan(&iqs263_tune_chans[i],
+                                (int16_t)iqs263_tune_deltas[i],
+                                iqs263_tune_touch[0] & (1 << i));
+    }
+
+    changed = 0;
+    memcpy(iqs263_tune_new, iqs263_thresholds, sizeof(iqs263_tune_new));
+    for (i = 0; i < IQS263_CHANNELS; i++) {
+        target = iqs263_tune_target(&iqs263_tune_chans[i]);
+        if (target == 0) {
+            continue;
+        }
+
+        if (i == 0) {
+            iqs263_tune_new[i] = iqs263_tune_clamp(target,
+                                                   cfg->prox_thr_min,
+                                                   cfg->prox_thr_max);
+        } else {
+            if (iqs263_tune_lta[i] == 0) {
+                continue;
+            }
+            iqs263_tune_new[i] = iqs263_tune_clamp(
+                (target * 256) / iqs263_tune_lta[i],
+                cfg->touch_thr_min, cfg->touch_thr_max);
+        }
+
+        diff = iqs263_tune_new[i] - iqs263_thresholds[i];
+        if (diff < 0) {
+            diff = -diff;
+        }
+        if (diff >= MYNEWT_VAL(IQS263_TUNE_HYSTERESIS)) {
+            changed = 1;
+        }
+    }
+
+    if (!changed) {
+        return;
+    }
+
+    /* Prox and touch thresholds are the first four bytes of the block */
+    if (iqs263_queue_write(IQS263_REGISTER_THRESHOLDS, iqs263_tune_new,
+                           IQS263_CHANNELS, iqs263_tune_write_cb, NULL) == 0) {
+        iqs263_request_window();
+    }
+}
+
+static void
+iqs263_tune_read_cb(int rc, void *arg)
+{
+    if (rc) {
+        iqs263_tune_rc = rc;
+    }
+
+    if (--iqs263_tune_remaining == 0 && iqs263_tune_rc == 0) {
+        iqs263_tune_evaluate();
+    }
+}
+
+static void
+iqs263_tune_sample(struct os_event *ev)
+{
+    int rc;
+
+    if (iqs263_tune_cfg == NULL) {
+        return;
+    }
+    os_callout_reset(&iqs263_tune_callout, iqs263_tune_period);
+
+    if (iqs263_tune_remaining) {
+        return;
+    }
+
+    iqs263_tune_rc = 0;
+    iqs263_tune_remaining = 3;
+
+    rc = iqs263_queue_read(IQS263_REGISTER_TOUCH_BYTES, iqs263_tune_touch,
+                           sizeof(iqs263_tune_touch), iqs263_tune_read_cb,
+                           NULL);
+    if (rc) {
+        iqs263_tune_remaining = 0;
+        return;
+    }
+
+    /* Channel words arrive low byte first, same as the nRF51 */
+    rc = iqs263_queue_read(IQS263_REGISTER_DELTAS,
+                           (uint8_t *)iqs263_tune_deltas,
+                           sizeof(iqs263_tune_deltas), iqs263_tune_read_cb,
+                           NULL);
+    if (rc) {
+        iqs263_tune_rc = rc;
+        iqs263_tune_remaining -= 2;
+        return;
+    }
+
+    rc = iqs263_queue_read(IQS263_REGISTER_LTA, (uint8_t *)iqs263_tune_lta,
+                           sizeof(iqs263_tune_lta), iqs263_tune_read_cb,
+                           NULL);
+    if (rc) {
+        iqs263_tune_rc = rc;
+        iqs263_tune_remaining -= 1;
+        return;
+    }
+
+    iqs263_request_window();
+}
+
+/**
+ * Thresholds to program at device init, the last ones tuned if any
+ *
+ * @param Buffer of IQS263_CHANNELS bytes: prox, touch CH1..CH3
+ */
+void
+iqs263_tune_get_thresholds(uint8_t *thresholds)
+{
+    memcpy(thresholds, iqs263_thresholds, sizeof(iqs263_thresholds));
+}
+
+/**
+ * Starts or stops the tuner according to the configuration
+ *
+ * @param The driver configuration, must stay valid while tuning
+ *
+ * @return 0 on success, non-zero error on failure.
+ */
+int
+iqs263_tune_config(struct iqs263_cfg *cfg)
+{
+    int rc;
+
+    os_callout_stop(&iqs263_tune_callout);
+    os_callout_init(&iqs263_tune_callout, iqs263_evq_get(),
+                    iqs263_tune_sample, NULL);
+
+    if (cfg->tune_period_ms == 0) {
+        iqs263_tune_cfg = NULL;
+        os_callout_stop(&iqs263_tune_callout);
+        return 0;
+    }
+
+    if (cfg->prox_thr_min > cfg->prox_thr_max ||
+        cfg->touch_thr_min > cfg->touch_thr_max) {
+        return SYS_EINVAL;
+    }
+
+    rc = os_time_ms_to_ticks(cfg->tune_period_ms, &iqs263_tune_period);
+    if (rc || iqs263_tune_period == 0) {
+        return SYS_EINVAL;
+    }
+
+    iqs263_tune_cfg = cfg;
+
+    return os_callout_reset(&iqs263_tune_callout, iqs263_tune_period);
+}